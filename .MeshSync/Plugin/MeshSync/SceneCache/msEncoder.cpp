@@ -5,6 +5,7 @@
 #ifdef msEnableZSTD
 #define ZSTD_STATIC_LINKING_ONLY
 #include <zstd.h>
+#include <zdict.h>
 #pragma comment(lib, "libzstd_static.lib")
 #endif
 
@@ -19,7 +20,7 @@ class PlainBufferEncoder : public BufferEncoder
 {
 public:
     void encode(RawVector<char>& dst, const RawVector<char>& src) override;
-    void decode(RawVector<char>& dst, const RawVector<char>& src) override;
+    void decode(RawVector<char>& dst, const char *src, size_t src_size) override;
 };
 
 void PlainBufferEncoder::encode(RawVector<char>& dst, const RawVector<char>& src)
@@ -27,9 +28,9 @@ void PlainBufferEncoder::encode(RawVector<char>& dst, const RawVector<char>& src
     dst = src;
 }
 
-void PlainBufferEncoder::decode(RawVector<char>& dst, const RawVector<char>& src)
+void PlainBufferEncoder::decode(RawVector<char>& dst, const char *src, size_t src_size)
 {
-    dst = src;
+    dst.assign(src, src + src_size);
 }
 
 BufferEncoderPtr CreatePlainEncoder() { return std::make_shared<PlainBufferEncoder>(); }
@@ -40,30 +41,292 @@ BufferEncoderPtr CreatePlainEncoder() { return std::make_shared<PlainBufferEncod
 class ZSTDBufferEncoder : public BufferEncoder
 {
 public:
+    ZSTDBufferEncoder(int compression_level, int window_log, const void *dict, size_t dict_size);
+    ~ZSTDBufferEncoder() override;
     void encode(RawVector<char>& dst, const RawVector<char>& src) override;
-    void decode(RawVector<char>& dst, const RawVector<char>& src) override;
+    void decode(RawVector<char>& dst, const char *src, size_t src_size) override;
+
+private:
+    // contexts are created on first use and reused. dictionary is loaded only once.
+    ZSTD_CCtx *m_cctx = nullptr;
+    ZSTD_DCtx *m_dctx = nullptr;
+    int m_compression_level = ZSTD_CLEVEL_DEFAULT;
+    int m_window_log = 0;
+    RawVector<char> m_dictionary;
 };
 
+ZSTDBufferEncoder::ZSTDBufferEncoder(int compression_level, int window_log, const void *dict, size_t dict_size)
+    : m_compression_level(compression_level)
+    , m_window_log(window_log)
+{
+    if (dict && dict_size > 0)
+        m_dictionary.assign((const char*)dict, (const char*)dict + dict_size);
+}
+
+ZSTDBufferEncoder::~ZSTDBufferEncoder()
+{
+    if (m_cctx)
+        ZSTD_freeCCtx(m_cctx);
+    if (m_dctx)
+        ZSTD_freeDCtx(m_dctx);
+}
+
 void ZSTDBufferEncoder::encode(RawVector<char>& dst, const RawVector<char>& src)
 {
+    if (!m_cctx) {
+        m_cctx = ZSTD_createCCtx();
+        ZSTD_CCtx_setParameter(m_cctx, ZSTD_c_compressionLevel, m_compression_level);
+        if (m_window_log > 0) {
+            ZSTD_CCtx_setParameter(m_cctx, ZSTD_c_enableLongDistanceMatching, 1);
+            ZSTD_CCtx_setParameter(m_cctx, ZSTD_c_windowLog, m_window_log);
+        }
+        if (!m_dictionary.empty())
+            ZSTD_CCtx_loadDictionary(m_cctx, m_dictionary.data(), m_dictionary.size());
+    }
+
     size_t size = ZSTD_compressBound(src.size());
     dst.resize_discard(size);
-    size_t csize = ZSTD_compress(dst.data(), dst.size(), src.data(), src.size(), ZSTD_CLEVEL_DEFAULT);
-    dst.resize(csize);
+    size_t csize = ZSTD_compress2(m_cctx, dst.data(), dst.size(), src.data(), src.size());
+    dst.resize(ZSTD_isError(csize) ? 0 : csize);
+}
+
+void ZSTDBufferEncoder::decode(RawVector<char>& dst, const char *src, size_t src_size)
+{
+    if (!m_dctx) {
+        m_dctx = ZSTD_createDCtx();
+        if (m_window_log > 0)
+            ZSTD_DCtx_setParameter(m_dctx, ZSTD_d_windowLogMax, m_window_log);
+        if (!m_dictionary.empty())
+            ZSTD_DCtx_loadDictionary(m_dctx, m_dictionary.data(), m_dictionary.size());
+    }
+
+    auto dsize = ZSTD_findDecompressedSize(src, src_size);
+    if (dsize == ZSTD_CONTENTSIZE_UNKNOWN || dsize == ZSTD_CONTENTSIZE_ERROR) {
+        dst.clear();
+        return;
+    }
+    dst.resize((size_t)dsize);
+    size_t ret = ZSTD_decompressDCtx(m_dctx, dst.data(), dst.size(), src, src_size);
+    dst.resize(ZSTD_isError(ret) ? 0 : ret);
 }
 
-void ZSTDBufferEncoder::decode(RawVector<char>& dst, const RawVector<char>& src)
+BufferEncoderPtr CreateZSTDEncoder(int compression_level, int window_log, const void *dict, size_t dict_size)
 {
-    size_t dsize = ZSTD_findDecompressedSize(src.data(), src.size());
-    dst.resize(dsize);
-    dsize = ZSTD_decompress(dst.data(), dst.size(), src.data(), src.size());
-    dst.resize(dsize);
+    return std::make_shared<ZSTDBufferEncoder>(compression_level, window_log, dict, dict_size);
 }
 
-BufferEncoderPtr CreateZSTDEncoder() { return std::make_shared<ZSTDBufferEncoder>(); }
+bool TrainZSTDDictionary(RawVector<char>& dst, size_t dict_size, const std::vector<const RawVector<char>*>& samples)
+{
+    RawVector<char> buf;
+    std::vector<size_t> sizes;
+    for (auto *s : samples) {
+        if (s->empty())
+            continue;
+        buf.insert(buf.end(), s->begin(), s->end());
+        sizes.push_back(s->size());
+    }
+
+    dst.resize_discard(dict_size);
+    size_t ret = ZDICT_trainFromBuffer(dst.data(), dst.size(), buf.data(), sizes.data(), (unsigned)sizes.size());
+    if (ZDICT_isError(ret)) {
+        dst.clear();
+        return false;
+    }
+    dst.resize(ret);
+    return true;
+}
 
 #else
-BufferEncoderPtr CreateZSTDEncoder() { return nullptr; }
+BufferEncoderPtr CreateZSTDEncoder(int, int, const void*, size_t) { return nullptr; }
+bool TrainZSTDDictionary(RawVector<char>& dst, size_t, const std::vector<const RawVector<char>*>&) { dst.clear(); return false; }
 #endif
 
+
+
+template<class PackedType, class PlainType>
+static void WriteBounded(std::ostream& os, const RawVector<PlainType>& src)
+{
+    mu::BoundedArray<PackedType, PlainType> tmp;
+    mu::encode(tmp, src);
+    write(os, tmp.bound_min);
+    write(os, tmp.bound_max);
+    write(os, tmp.packed);
+}
+
+template<class PackedType, class PlainType>
+static void ReadBounded(std::istream& is, RawVector<PlainType>& dst)
+{
+    mu::BoundedArray<PackedType, PlainType> tmp;
+    read(is, tmp.bound_min);
+    read(is, tmp.bound_max);
+    read(is, tmp.packed);
+    mu::decode(dst, tmp);
+}
+
+template<class T>
+static inline bool BeginEncode(std::ostream& os, const RawVector<T>& src, VertexArrayEncoding& encoding)
+{
+    if (src.empty())
+        encoding = VertexArrayEncoding::Empty;
+    write(os, encoding);
+    if (encoding == VertexArrayEncoding::Plain)
+        write(os, src);
+    return encoding != VertexArrayEncoding::Empty && encoding != VertexArrayEncoding::Plain;
+}
+
+template<class T>
+static inline bool BeginDecode(std::istream& is, RawVector<T>& dst, VertexArrayEncoding& encoding)
+{
+    read(is, encoding);
+    if (encoding == VertexArrayEncoding::Empty)
+        dst.clear();
+    else if (encoding == VertexArrayEncoding::Plain)
+        read(is, dst);
+    return encoding != VertexArrayEncoding::Empty && encoding != VertexArrayEncoding::Plain;
+}
+
+void EncodeVertexArray(std::ostream& os, const RawVector<float2>& src, VertexArrayEncoding encoding)
+{
+    if (encoding != VertexArrayEncoding::Bounded8 && encoding != VertexArrayEncoding::Bounded16)
+        encoding = VertexArrayEncoding::Plain;
+    if (!BeginEncode(os, src, encoding))
+        return;
+
+    switch (encoding) {
+    case VertexArrayEncoding::Bounded8: WriteBounded<unorm8x2>(os, src); break;
+    case VertexArrayEncoding::Bounded16: WriteBounded<unorm16x2>(os, src); break;
+    default: break;
+    }
+}
+
+void EncodeVertexArray(std::ostream& os, const RawVector<float3>& src, VertexArrayEncoding encoding)
+{
+    if (encoding != VertexArrayEncoding::Bounded8 && encoding != VertexArrayEncoding::Bounded16 && encoding != VertexArrayEncoding::S10x3)
+        encoding = VertexArrayEncoding::Plain;
+    if (!BeginEncode(os, src, encoding))
+        return;
+
+    switch (encoding) {
+    case VertexArrayEncoding::Bounded8: WriteBounded<unorm8x3>(os, src); break;
+    case VertexArrayEncoding::Bounded16: WriteBounded<unorm16x3>(os, src); break;
+    case VertexArrayEncoding::S10x3:
+    {
+        PackedArrayS10x3 tmp;
+        mu::encode(tmp, src);
+        write(os, tmp.packed);
+        break;
+    }
+    default: break;
+    }
+}
+
+void EncodeVertexArray(std::ostream& os, const RawVector<float4>& src, VertexArrayEncoding encoding)
+{
+    if (encoding != VertexArrayEncoding::Bounded8 && encoding != VertexArrayEncoding::Bounded16 && encoding != VertexArrayEncoding::S10x3)
+        encoding = VertexArrayEncoding::Plain;
+    if (!BeginEncode(os, src, encoding))
+        return;
+
+    switch (encoding) {
+    case VertexArrayEncoding::Bounded8: WriteBounded<unorm8x4>(os, src); break;
+    case VertexArrayEncoding::Bounded16: WriteBounded<unorm16x4>(os, src); break;
+    case VertexArrayEncoding::S10x3:
+    {
+        PackedArrayS10x3 tmp;
+        mu::encode_tangents(tmp, src);
+        write(os, tmp.packed);
+        break;
+    }
+    default: break;
+    }
+}
+
+void EncodeVertexArray(std::ostream& os, const RawVector<int>& src)
+{
+    auto encoding = VertexArrayEncoding::Plain;
+    if (!src.empty()) {
+        int vmin, vmax;
+        MinMax(src.data(), src.size(), vmin, vmax);
+        int64_t range = (int64_t)vmax - (int64_t)vmin;
+        if (range <= 0xff)
+            encoding = VertexArrayEncoding::U8;
+        else if (range <= 0xffff)
+            encoding = VertexArrayEncoding::U16;
+    }
+    if (!BeginEncode(os, src, encoding))
+        return;
+
+    switch (encoding) {
+    case VertexArrayEncoding::U8: WriteBounded<uint8_t>(os, src); break;
+    case VertexArrayEncoding::U16: WriteBounded<uint16_t>(os, src); break;
+    default: break;
+    }
+}
+
+void DecodeVertexArray(std::istream& is, RawVector<float2>& dst)
+{
+    VertexArrayEncoding encoding;
+    if (!BeginDecode(is, dst, encoding))
+        return;
+
+    switch (encoding) {
+    case VertexArrayEncoding::Bounded8: ReadBounded<unorm8x2>(is, dst); break;
+    case VertexArrayEncoding::Bounded16: ReadBounded<unorm16x2>(is, dst); break;
+    default: throw std::runtime_error("unknown vertex array encoding");
+    }
+}
+
+void DecodeVertexArray(std::istream& is, RawVector<float3>& dst)
+{
+    VertexArrayEncoding encoding;
+    if (!BeginDecode(is, dst, encoding))
+        return;
+
+    switch (encoding) {
+    case VertexArrayEncoding::Bounded8: ReadBounded<unorm8x3>(is, dst); break;
+    case VertexArrayEncoding::Bounded16: ReadBounded<unorm16x3>(is, dst); break;
+    case VertexArrayEncoding::S10x3:
+    {
+        PackedArrayS10x3 tmp;
+        read(is, tmp.packed);
+        mu::decode(dst, tmp);
+        break;
+    }
+    default: throw std::runtime_error("unknown vertex array encoding");
+    }
+}
+
+void DecodeVertexArray(std::istream& is, RawVector<float4>& dst)
+{
+    VertexArrayEncoding encoding;
+    if (!BeginDecode(is, dst, encoding))
+        return;
+
+    switch (encoding) {
+    case VertexArrayEncoding::Bounded8: ReadBounded<unorm8x4>(is, dst); break;
+    case VertexArrayEncoding::Bounded16: ReadBounded<unorm16x4>(is, dst); break;
+    case VertexArrayEncoding::S10x3:
+    {
+        PackedArrayS10x3 tmp;
+        read(is, tmp.packed);
+        mu::decode_tangents(dst, tmp);
+        break;
+    }
+    default: throw std::runtime_error("unknown vertex array encoding");
+    }
+}
+
+void DecodeVertexArray(std::istream& is, RawVector<int>& dst)
+{
+    VertexArrayEncoding encoding;
+    if (!BeginDecode(is, dst, encoding))
+        return;
+
+    switch (encoding) {
+    case VertexArrayEncoding::U8: ReadBounded<uint8_t>(is, dst); break;
+    case VertexArrayEncoding::U16: ReadBounded<uint16_t>(is, dst); break;
+    default: throw std::runtime_error("unknown vertex array encoding");
+    }
+}
+
 } // namespace ms
@@ -9,21 +9,17 @@ class BufferEncoder
 public:
     virtual ~BufferEncoder();
     virtual void encode(RawVector<char>& dst, const RawVector<char>& src) = 0;
-    virtual void decode(RawVector<char>& dst, const RawVector<char>& src) = 0;
+    virtual void decode(RawVector<char>& dst, const char *src, size_t src_size) = 0;
+    void decode(RawVector<char>& dst, const RawVector<char>& src) { decode(dst, src.data(), src.size()); }
 };
 msDeclPtr(BufferEncoder);
 
 BufferEncoderPtr CreatePlainEncoder();
-BufferEncoderPtr CreateZSTDEncoder();
-
-
-class MeshEncoder
-{
-public:
-    virtual ~MeshEncoder();
-    virtual void encode(RawVector<char>& dst, const Mesh&& src) = 0;
-    virtual void decode(Mesh& dst, const RawVector<char>& src) = 0;
-};
+// window_log: > 0 enables long distance matching with window of 2^window_log bytes.
+// dict: optional. copied into the encoder.
+BufferEncoderPtr CreateZSTDEncoder(int compression_level = 3, int window_log = 0, const void *dict = nullptr, size_t dict_size = 0);
+// train a dictionary from samples. returns false if ZSTD is not available or training failed (e.g. too few samples).
+bool TrainZSTDDictionary(RawVector<char>& dst, size_t dict_size, const std::vector<const RawVector<char>*>& samples);
 
 
 enum class VertexArrayEncoding
@@ -34,7 +30,7 @@ enum class VertexArrayEncoding
     // float array encodings
     Bounded8,
     Bounded16,
-    S10x3,
+    S10x3, // float3: normalized vector. float4: tangent (xyz normalized, w sign)
 
     // int array encodings
     I8,
@@ -44,14 +40,17 @@ enum class VertexArrayEncoding
     U24,
 };
 
-struct MeshEncodeSettings
-{
-    uint32_t quantize_points : 1;
-    uint32_t quantize_normals : 1;
-    uint32_t quantize_tangents : 1;
-    uint32_t quantize_uv : 1;
-    uint32_t quantize_colors : 1;
-    uint32_t quantize_velocities : 1;
-};
+// the encoding is written first, so DecodeVertexArray() needs no settings.
+// falls back to Plain if the encoding is not applicable to the type.
+void EncodeVertexArray(std::ostream& os, const RawVector<float2>& src, VertexArrayEncoding encoding);
+void EncodeVertexArray(std::ostream& os, const RawVector<float3>& src, VertexArrayEncoding encoding);
+void EncodeVertexArray(std::ostream& os, const RawVector<float4>& src, VertexArrayEncoding encoding);
+// lossless. packed into the smallest of U8 / U16 / Plain that can hold the value range.
+void EncodeVertexArray(std::ostream& os, const RawVector<int>& src);
+
+void DecodeVertexArray(std::istream& is, RawVector<float2>& dst);
+void DecodeVertexArray(std::istream& is, RawVector<float3>& dst);
+void DecodeVertexArray(std::istream& is, RawVector<float4>& dst);
+void DecodeVertexArray(std::istream& is, RawVector<int>& dst);
 
 } // namespace ms
@@ -16,6 +16,23 @@ enum class SceneCacheEncoding
 struct SceneCacheSettings
 {
     SceneCacheEncoding encoding = SceneCacheEncoding::ZSTD;
+    int zstd_compression_level = 3; // 1 (fastest) - 22 (smallest)
+    int zstd_dictionary_size = 0; // > 0: train a dictionary from the first frame and store it in the file
+    int zstd_window_log = 0; // > 0: enable long distance matching with window of 2^zstd_window_log bytes
+    MeshEncodeSettings mesh_encode_settings = { 0 }; // combined with Mesh::encode_settings of each mesh
+    int keyframe_interval = 0; // > 1: meshes between keyframes are stored as residuals from the previous frame. ZSTD only
+};
+
+struct OSceneCacheSettings
+{
+    int max_queue_size = 8; // max number of frames being encoded. addScene() blocks when exceeded
+    int num_threads = 0; // number of encoder threads. 0: number of cores
+};
+
+struct ISceneCacheSettings
+{
+    int max_history = 8; // number of decoded scenes kept in memory
+    int preload_length = 2; // number of frames decoded ahead in the background. 0 disables prefetch
 };
 
 
@@ -36,17 +53,21 @@ public:
     virtual ~ISceneCache();
     virtual std::tuple<float, float> getTimeRange() const = 0;
     virtual size_t getNumScenes() const = 0;
+    // entities and assets that didn't change between frames are shared by returned scenes.
+    // treat them as read-only.
     virtual ScenePtr getByIndex(size_t i) = 0;
     virtual ScenePtr getByTime(float t, bool lerp) = 0;
+    // load only entities that match paths. assets and constraints are skipped.
+    virtual ScenePtr getByIndex(size_t i, const std::vector<std::string>& paths) = 0;
 };
 msDeclPtr(ISceneCache);
 
 
-OSceneCachePtr OpenOSceneCacheFile(const char *path, const SceneCacheSettings& settings = SceneCacheSettings());
-OSceneCache* OpenOSceneCacheFileRaw(const char *path, const SceneCacheSettings& settings = SceneCacheSettings());
+OSceneCachePtr OpenOSceneCacheFile(const char *path, const SceneCacheSettings& settings = SceneCacheSettings(), const OSceneCacheSettings& osettings = OSceneCacheSettings());
+OSceneCache* OpenOSceneCacheFileRaw(const char *path, const SceneCacheSettings& settings = SceneCacheSettings(), const OSceneCacheSettings& osettings = OSceneCacheSettings());
 
-ISceneCachePtr OpenISceneCacheFile(const char *path);
-ISceneCache* OpenISceneCacheFileRaw(const char *path);
+ISceneCachePtr OpenISceneCacheFile(const char *path, const ISceneCacheSettings& settings = ISceneCacheSettings());
+ISceneCache* OpenISceneCacheFileRaw(const char *path, const ISceneCacheSettings& settings = ISceneCacheSettings());
 
 
 } // namespace ms
@@ -1,19 +1,52 @@
 #include "pch.h"
 #include "msSceneCache.h"
 #include "msSceneCacheImpl.h"
+#include "SceneGraph/msConstraints.h"
 
 namespace ms {
 
-static BufferEncoderPtr CreateEncoder(SceneCacheEncoding encoding)
+static BufferEncoderPtr CreateEncoder(const SceneCacheSettings& settings, const RawVector<char>& dictionary)
 {
     BufferEncoderPtr ret;
-    switch (encoding) {
-    case SceneCacheEncoding::ZSTD: ret = CreateZSTDEncoder(); break;
+    switch (settings.encoding) {
+    case SceneCacheEncoding::Plain: ret = CreatePlainEncoder(); break;
+    case SceneCacheEncoding::ZSTD:
+        ret = CreateZSTDEncoder(settings.zstd_compression_level, settings.zstd_window_log, dictionary.data(), dictionary.size());
+        break;
     default: break;
     }
     return ret;
 }
 
+
+#define EachMember(F)\
+    F(type) F(path) F(pos) F(size) F(delta)
+
+void CacheChunkDesc::serialize(std::ostream& os) const
+{
+    EachMember(msWrite);
+}
+void CacheChunkDesc::deserialize(std::istream& is)
+{
+    EachMember(msRead);
+}
+#undef EachMember
+
+
+#define EachMember(F)\
+    F(settings) F(chunks)
+
+void CacheFrameIndex::serialize(std::ostream& os) const
+{
+    EachMember(msWrite);
+}
+void CacheFrameIndex::deserialize(std::istream& is)
+{
+    EachMember(msRead);
+}
+#undef EachMember
+
+
 OSceneCache::~OSceneCache()
 {
 }
@@ -30,50 +63,70 @@ OSceneCacheImpl::~OSceneCacheImpl()
 {
     if (valid()) {
         flush();
+        m_task_pool.reset();
+        if (!m_header_written)
+            writeHeader();
 
         // add terminator
         auto terminator = CacheFileSceneHeader::terminator();
         m_ost->write((char*)&terminator, sizeof(terminator));
+        m_pos += sizeof(terminator);
+
+        // frame table and footer
+        CacheFileFooter footer;
+        footer.num_frames = (uint32_t)m_frames.size();
+        footer.table_pos = m_pos;
+        m_ost->write((char*)m_frames.data(), sizeof(CacheFileFrameEntry) * m_frames.size());
+        m_ost->write((char*)&footer, sizeof(footer));
     }
 }
 
 void OSceneCacheImpl::addScene(ScenePtr scene, float time)
 {
-    {
-        std::unique_lock<std::mutex> l(m_mutex);
-        m_queue.push_back({ scene, time });
-    }
-    doWrite();
+    if (!valid() || !scene)
+        return;
+
+    std::unique_lock<std::mutex> l(m_mutex);
+    // backpressure
+    m_cond.wait(l, [this]() { return m_next_seq - m_write_seq < (uint64_t)m_osettings.max_queue_size; });
+
+    auto task = std::make_shared<FrameTask>();
+    task->seq = m_next_seq++;
+    task->time = time;
+    task->scene = scene;
+    // push in seq order. a task waits only for tasks with smaller seq, so they must be taken first.
+    m_task_pool->push([this, task]() { encodeFrame(task); });
 }
 
 void OSceneCacheImpl::flush()
 {
-    doWrite();
-    if (m_task.valid())
-        m_task.wait();
+    std::unique_lock<std::mutex> l(m_mutex);
+    m_cond.wait(l, [this]() { return m_write_seq == m_next_seq; });
 }
 
 bool OSceneCacheImpl::isWriting()
 {
-    return m_task.valid() && m_task.wait_for(std::chrono::milliseconds(0)) == std::future_status::timeout;
+    std::unique_lock<std::mutex> l(m_mutex);
+    return m_write_seq != m_next_seq;
 }
 
-bool OSceneCacheImpl::prepare(ostream_ptr ost, const SceneCacheSettings& settings)
+bool OSceneCacheImpl::prepare(ostream_ptr ost, const SceneCacheSettings& settings, const OSceneCacheSettings& osettings)
 {
     m_ost = ost;
     m_settings = settings;
+    m_osettings = osettings;
+    m_osettings.max_queue_size = std::max(m_osettings.max_queue_size, 1);
     if (!m_ost)
         return false;
 
-    m_encoder = CreateEncoder(m_settings.encoding);
-    if (!m_encoder) {
+    if (!CreateEncoder(m_settings, m_dictionary))
         m_settings.encoding = SceneCacheEncoding::Plain;
-        m_encoder = CreatePlainEncoder();
+    if (m_settings.encoding != SceneCacheEncoding::ZSTD) {
+        // residuals are only worth it when compressed
+        m_settings.zstd_dictionary_size = 0;
+        m_settings.keyframe_interval = 0;
     }
-
-    CacheFileHeader header;
-    header.settings = m_settings;
-    m_ost->write((char*)&header, sizeof(header));
+    m_task_pool.reset(new mu::thread_pool(m_osettings.num_threads));
     return valid();
 }
 
@@ -82,48 +135,232 @@ bool OSceneCacheImpl::valid() const
     return m_ost != nullptr;
 }
 
-void OSceneCacheImpl::doWrite()
+BufferEncoderPtr OSceneCacheImpl::acquireEncoder()
 {
-    auto body = [this]() {
-        for (;;) {
-            SceneDesc desc;
-            {
-                std::unique_lock<std::mutex> l(m_mutex);
-                if (m_queue.empty()) {
-                    break;
-                }
-                else {
-                    desc = m_queue.back();
-                    m_queue.pop_back();
-                }
-            }
-            if (!desc.scene)
-                continue;
-
+    {
+        std::unique_lock<std::mutex> l(m_mutex);
+        if (!m_encoders.empty()) {
+            auto ret = m_encoders.back();
+            m_encoders.pop_back();
+            return ret;
+        }
+    }
+    return CreateEncoder(m_settings, m_dictionary);
+}
 
-            // serialize
-            m_scene_buf.reset();
-            desc.scene->serialize(m_scene_buf);
-            m_scene_buf.flush();
+void OSceneCacheImpl::releaseEncoder(BufferEncoderPtr encoder)
+{
+    std::unique_lock<std::mutex> l(m_mutex);
+    m_encoders.push_back(encoder);
+}
 
-            // encode
-            m_encoder->encode(m_encoded_buf, m_scene_buf.getBuffer());
+void OSceneCacheImpl::encodeFrame(FrameTaskPtr task)
+{
+    // serialize
+    {
+        auto& scene = *task->scene;
+        MemoryStream buf;
+        auto add = [&](CacheChunkType type, const std::string& path, const auto& body, EntityPtr entity = nullptr) {
+            buf.reset();
+            body(buf);
+            buf.flush();
+
+            EncodedChunk chunk;
+            chunk.type = type;
+            chunk.path = path;
+            chunk.entity = entity;
+            chunk.data = std::make_shared<RawVector<char>>(buf.getBuffer());
+            task->chunks.push_back(std::move(chunk));
+        };
+        for (auto& asset : scene.assets)
+            add(CacheChunkType::Asset, asset->name, [&asset](std::ostream& os) { asset->serialize(os); });
+        auto mes = (uint32_t&)m_settings.mesh_encode_settings;
+        for (auto& entity : scene.entities) {
+            if (mes && entity->getType() == Entity::Type::Mesh) {
+                auto& mesh = static_cast<const Mesh&>(*entity);
+                auto es = (uint32_t&)mesh.encode_settings | mes;
+                add(CacheChunkType::Entity, entity->path, [&mesh, &es](std::ostream& os) { mesh.serialize(os, (MeshEncodeSettings&)es); }, entity);
+            }
+            else {
+                add(CacheChunkType::Entity, entity->path, [&entity](std::ostream& os) { entity->serialize(os); }, entity);
+            }
+        }
+        for (auto& constraint : scene.constraints)
+            add(CacheChunkType::Constraint, constraint->path, [&constraint](std::ostream& os) { constraint->serialize(os); });
+        task->settings = scene.settings;
+        task->scene.reset();
+    }
 
-            // write
-            CacheFileSceneHeader header{ m_encoded_buf.size(), desc.time };
-            m_ost->write((char*)&header, sizeof(header));
-            m_ost->write(m_encoded_buf.data(), m_encoded_buf.size());
+    // compare with the last data with same path. unchanged ones are not written again.
+    {
+        std::unique_lock<std::mutex> l(m_mutex);
+        m_cond.wait(l, [this, &task]() { return m_compare_seq == task->seq; });
+    }
+    for (auto& chunk : task->chunks) {
+        auto& last = m_chunk_history[ChunkKey{ chunk.type, chunk.path }];
+        if (!last.data || *last.data != *chunk.data) {
+            chunk.changed = true;
+
+            // meshes with same topology as the last frame are stored as residuals until the next keyframe
+            if (last.data && last.data->size() == chunk.data->size() && last.delta_count + 1 < m_settings.keyframe_interval &&
+                chunk.entity && chunk.entity->getType() == Entity::Type::Mesh &&
+                last.entity && last.entity->getType() == Entity::Type::Mesh) {
+                chunk.delta = static_cast<Mesh&>(*chunk.entity).isTopologyCompatible(static_cast<Mesh&>(*last.entity));
+            }
+            if (chunk.delta) {
+                chunk.base = last.data;
+                ++last.delta_count;
+            }
+            else {
+                last.delta_count = 0;
+            }
+            last.data = chunk.data;
+        }
+        if (m_settings.keyframe_interval > 1)
+            last.entity = chunk.entity;
+        chunk.entity.reset();
+    }
+    if (task->seq == 0 && m_settings.zstd_dictionary_size > 0) {
+        // encoders are created after this point, so all chunks are compressed with the dictionary
+        std::vector<const RawVector<char>*> samples;
+        for (auto& chunk : task->chunks)
+            samples.push_back(chunk.data.get());
+        if (!TrainZSTDDictionary(m_dictionary, m_settings.zstd_dictionary_size, samples))
+            msLogWarning("failed to train ZSTD dictionary. continue without dictionary.\n");
+    }
+    {
+        std::unique_lock<std::mutex> l(m_mutex);
+        ++m_compare_seq;
+    }
+    m_cond.notify_all();
+
+    // compress
+    auto encoder = acquireEncoder();
+    RawVector<char> residual;
+    for (auto& chunk : task->chunks) {
+        if (chunk.delta) {
+            auto& data = *chunk.data;
+            auto& base = *chunk.base;
+            residual.resize_discard(data.size());
+            for (size_t i = 0; i < data.size(); ++i)
+                residual[i] = data[i] ^ base[i];
+            encoder->encode(chunk.encoded, residual);
+            chunk.base.reset();
+        }
+        else if (chunk.changed) {
+            encoder->encode(chunk.encoded, *chunk.data);
         }
-    };
+        chunk.data.reset();
+    }
+    releaseEncoder(encoder);
 
+    // hand over to the writer. if no one is writing, this thread becomes the writer.
     {
         std::unique_lock<std::mutex> l(m_mutex);
-        if (!m_queue.empty() && !isWriting()) {
-            m_task = std::async(std::launch::async, body);
+        m_encoded_frames[task->seq] = task;
+        if (m_writing)
+            return;
+        m_writing = true;
+    }
+    writeFrames();
+}
+
+void OSceneCacheImpl::writeFrames()
+{
+    for (;;) {
+        FrameTaskPtr task;
+        {
+            std::unique_lock<std::mutex> l(m_mutex);
+            auto it = m_encoded_frames.find(m_write_seq);
+            if (it == m_encoded_frames.end()) {
+                m_writing = false;
+                return;
+            }
+            task = it->second;
+            m_encoded_frames.erase(it);
         }
+
+        writeFrame(*task);
+        {
+            std::unique_lock<std::mutex> l(m_mutex);
+            ++m_write_seq;
+        }
+        m_cond.notify_all();
     }
 }
 
+void OSceneCacheImpl::writeHeader()
+{
+    CacheFileHeader header;
+    header.settings = m_settings;
+    header.dictionary_size = m_dictionary.size();
+    m_ost->write((char*)&header, sizeof(header));
+    m_ost->write(m_dictionary.data(), m_dictionary.size());
+    m_pos = sizeof(header) + m_dictionary.size();
+
+    m_encoder = CreateEncoder(m_settings, m_dictionary);
+    m_header_written = true;
+}
+
+void OSceneCacheImpl::writeFrame(FrameTask& task)
+{
+    if (!m_header_written)
+        writeHeader();
+
+    uint64_t record_pos = m_pos + sizeof(CacheFileSceneHeader);
+    m_record_buf.clear();
+    m_index.settings = task.settings;
+    m_index.chunks.clear();
+
+    // chunks. unchanged ones refer the last written one.
+    for (auto& chunk : task.chunks) {
+        auto& desc = m_chunk_descs[ChunkKey{ chunk.type, chunk.path }];
+        if (chunk.changed) {
+            uint64_t pos = record_pos + m_record_buf.size();
+            if (chunk.delta) {
+                // base is the last written chunk with the same path
+                CacheDeltaHeader dh;
+                dh.base_pos = desc.pos;
+                dh.base_size = desc.size;
+                dh.base_delta = desc.delta;
+                m_record_buf.insert(m_record_buf.end(), (const char*)&dh, (const char*)&dh + sizeof(dh));
+            }
+            m_record_buf.insert(m_record_buf.end(), chunk.encoded.begin(), chunk.encoded.end());
+
+            desc.type = chunk.type;
+            desc.path = chunk.path;
+            desc.pos = pos;
+            desc.size = record_pos + m_record_buf.size() - pos;
+            desc.delta = chunk.delta;
+        }
+        m_index.chunks.push_back(desc);
+    }
+
+    // index
+    m_scene_buf.reset();
+    m_index.serialize(m_scene_buf);
+    m_scene_buf.flush();
+    m_encoder->encode(m_encoded_buf, m_scene_buf.getBuffer());
+    m_record_buf.insert(m_record_buf.end(), m_encoded_buf.begin(), m_encoded_buf.end());
+
+    // write
+    CacheFileSceneHeader header;
+    header.size = m_record_buf.size();
+    header.index_size = m_encoded_buf.size();
+    header.time = task.time;
+    m_ost->write((char*)&header, sizeof(header));
+    m_ost->write(m_record_buf.data(), m_record_buf.size());
+
+    CacheFileFrameEntry entry;
+    entry.pos = record_pos;
+    entry.size = header.size;
+    entry.index_size = header.index_size;
+    entry.time = task.time;
+    m_frames.push_back(entry);
+
+    m_pos += sizeof(header) + m_record_buf.size();
+}
+
 
 ISceneCacheImpl::ISceneCacheImpl()
 {
@@ -131,46 +368,142 @@ ISceneCacheImpl::ISceneCacheImpl()
 
 ISceneCacheImpl::~ISceneCacheImpl()
 {
+    if (m_prefetch_thread.joinable()) {
+        {
+            std::unique_lock<std::mutex> l(m_mutex);
+            m_prefetch_stop = true;
+        }
+        m_prefetch_cond.notify_all();
+        m_prefetch_thread.join();
+    }
 }
 
-bool ISceneCacheImpl::prepare(istream_ptr ist)
+bool ISceneCacheImpl::prepare(istream_ptr ist, const ISceneCacheSettings& settings)
 {
     m_ist = ist;
     if (!m_ist)
         return false;
 
-    CacheFileHeader header;
-    header.version = 0;
-    m_ist->read((char*)&header, sizeof(header));
-    m_settings = header.settings;
+    m_ist->seekg(0, std::ios::end);
+    m_file_size = (uint64_t)m_ist->tellg();
+    m_ist->seekg(0, std::ios::beg);
+    return prepareImpl(settings);
+}
+
+bool ISceneCacheImpl::prepare(const char *path, const ISceneCacheSettings& settings)
+{
+    if (!m_mapped.open(path))
+        return false;
+
+    m_file_size = m_mapped.size();
+    return prepareImpl(settings);
+}
 
+bool ISceneCacheImpl::prepareImpl(const ISceneCacheSettings& settings)
+{
+    m_isettings = settings;
+    // prefetched frames must survive until they are used
+    m_isettings.max_history = std::max(m_isettings.max_history, m_isettings.preload_length + 2);
+
+    // copy headers as they are not aligned in the mapped region
+    CacheFileHeader header;
+    if (auto *src = readBuffer(0, sizeof(header)))
+        memcpy(&header, src, sizeof(header));
+    else
+        return false;
     if (header.version != msProtocolVersion)
         return false;
+    m_settings = header.settings;
+
+    RawVector<char> dictionary;
+    if (header.dictionary_size > 0) {
+        auto *src = readBuffer(sizeof(header), header.dictionary_size);
+        if (!src)
+            return false;
+        dictionary.assign(src, src + header.dictionary_size);
+    }
+    m_frames_pos = sizeof(header) + header.dictionary_size;
 
-    m_encoder = CreateEncoder(m_settings.encoding);
+    m_encoder = CreateEncoder(m_settings, dictionary);
     if (!m_encoder) {
         // encoder associated with m_settings.encoding is not available
         return false;
     }
 
+    if (!readFrameTable())
+        scanFrames();
+    std::sort(m_descs.begin(), m_descs.end(), [](auto& a, auto& b) { return a.time < b.time; });
+
+    if (valid() && m_isettings.preload_length > 0)
+        m_prefetch_thread = std::thread([this]() { processPrefetch(); });
+    return valid();
+}
+
+bool ISceneCacheImpl::readFrameTable()
+{
+    CacheFileFooter footer;
+    if (m_file_size < m_frames_pos + sizeof(footer))
+        return false;
+    if (auto *src = readBuffer(m_file_size - sizeof(footer), sizeof(footer)))
+        memcpy(&footer, src, sizeof(footer));
+    else
+        return false;
+
+    if (memcmp(footer.magic, CacheFileFooter().magic, sizeof(footer.magic)) != 0 ||
+        footer.table_pos < m_frames_pos ||
+        footer.table_pos + sizeof(CacheFileFrameEntry) * footer.num_frames + sizeof(footer) != m_file_size)
+        return false;
+
+    std::vector<CacheFileFrameEntry> entries(footer.num_frames);
+    size_t table_size = sizeof(CacheFileFrameEntry) * entries.size();
+    if (auto *src = readBuffer(footer.table_pos, table_size))
+        memcpy(entries.data(), src, table_size);
+    else
+        return false;
+
+    m_descs.resize(entries.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        auto& e = entries[i];
+        if (e.pos + e.size > footer.table_pos || e.index_size > e.size) {
+            m_descs.clear();
+            return false;
+        }
+        auto& desc = m_descs[i];
+        desc.pos = e.pos;
+        desc.size = e.size;
+        desc.index_size = e.index_size;
+        desc.time = e.time;
+    }
+    return true;
+}
+
+void ISceneCacheImpl::scanFrames()
+{
+    m_descs.clear();
+    uint64_t pos = m_frames_pos;
     for (;;) {
         CacheFileSceneHeader sh;
-        m_ist->read((char*)&sh, sizeof(sh));
-        if (sh.size == 0) {
+        auto *src = readBuffer(pos, sizeof(sh));
+        if (!src)
+            break;
+        memcpy(&sh, src, sizeof(sh));
+        if (sh.size == 0)
+            break;
+
+        pos += sizeof(sh);
+        if (pos + sh.size > m_file_size) {
+            // truncated
             break;
         }
-        else {
-            SceneDesc desc;
-            desc.pos = (uint64_t)m_ist->tellg();
-            desc.size = sh.size;
-            desc.time = sh.time;
-            m_descs.push_back(desc);
-
-            m_ist->seekg(sh.size, std::ios::cur);
-        }
+
+        SceneDesc desc;
+        desc.pos = pos;
+        desc.size = sh.size;
+        desc.index_size = sh.index_size;
+        desc.time = sh.time;
+        m_descs.push_back(desc);
+        pos += sh.size;
     }
-    std::sort(m_descs.begin(), m_descs.end(), [](auto& a, auto& b) { return a.time < b.time; });
-    return valid();
 }
 
 bool ISceneCacheImpl::valid() const
@@ -190,77 +523,290 @@ std::tuple<float, float> ISceneCacheImpl::getTimeRange() const
     return { m_descs.front().time, m_descs.back().time };
 }
 
-ScenePtr ISceneCacheImpl::getByIndex(size_t i)
+const char* ISceneCacheImpl::readBuffer(uint64_t pos, uint64_t size)
 {
-    if (m_descs.empty())
-        return ScenePtr();
+    if (pos + size > m_file_size)
+        return nullptr;
 
-    auto& desc = m_descs[i];
+    if (m_mapped.valid())
+        return m_mapped.data() + pos;
 
-    // read
-    m_encoded_buf.resize(desc.size);
-    m_ist->seekg(desc.pos, std::ios::beg);
+    m_encoded_buf.resize_discard((size_t)size);
+    m_ist->seekg(pos, std::ios::beg);
     m_ist->read(m_encoded_buf.data(), m_encoded_buf.size());
+    if (!*m_ist) {
+        m_ist->clear();
+        return nullptr;
+    }
+    return m_encoded_buf.data();
+}
+
+bool ISceneCacheImpl::decodeChunk(uint64_t pos, uint64_t size, bool delta, RawVector<char>& dst)
+{
+    // the base is likely in the last loaded frame
+    auto it = m_chunk_cache.find(pos);
+    if (it != m_chunk_cache.end() && it->second.data) {
+        dst = *it->second.data;
+        return true;
+    }
+
+    auto *src = readBuffer(pos, size);
+    if (!src)
+        return false;
+    if (!delta) {
+        m_encoder->decode(dst, src, (size_t)size);
+        return true;
+    }
+
+    CacheDeltaHeader dh;
+    if (size < sizeof(dh))
+        return false;
+    memcpy(&dh, src, sizeof(dh));
+    // src is invalidated by the next read
+    RawVector<char> residual;
+    m_encoder->decode(residual, src + sizeof(dh), (size_t)size - sizeof(dh));
+
+    if (!decodeChunk(dh.base_pos, dh.base_size, dh.base_delta != 0, dst) || dst.size() != residual.size())
+        return false;
+    for (size_t i = 0; i < dst.size(); ++i)
+        dst[i] ^= residual[i];
+    return true;
+}
 
-    // decode
-    m_encoder->decode(m_tmp_buf, m_encoded_buf);
+bool ISceneCacheImpl::readChunk(uint64_t pos, uint64_t size, bool delta)
+{
+    if (!decodeChunk(pos, size, delta, m_tmp_buf))
+        return false;
     m_scene_buf.swap(m_tmp_buf);
+    return true;
+}
 
-    // deserialize
+ScenePtr ISceneCacheImpl::loadScene(size_t i, const std::vector<std::string> *paths)
+{
+    if (i >= m_descs.size())
+        return ScenePtr();
+
+    auto& desc = m_descs[i];
     try {
-        m_last_scene = Scene::create();
-        m_last_scene->deserialize(m_scene_buf);
-        return m_last_scene;
+        // index
+        if (!readChunk(desc.pos + desc.size - desc.index_size, desc.index_size))
+            throw std::runtime_error("failed to read frame index");
+        CacheFrameIndex index;
+        index.deserialize(m_scene_buf);
+
+        auto ret = Scene::create();
+        ret->settings = index.settings;
+
+        // chunks. unchanged ones are taken from the last loaded frame.
+        std::map<uint64_t, ChunkObject> chunk_cache;
+        for (auto& cd : index.chunks) {
+            if (paths) {
+                if (cd.type != CacheChunkType::Entity || std::find(paths->begin(), paths->end(), cd.path) == paths->end())
+                    continue;
+            }
+
+            ChunkObject obj;
+            auto it = m_chunk_cache.find(cd.pos);
+            if (it != m_chunk_cache.end()) {
+                obj = it->second;
+            }
+            else {
+                if (!readChunk(cd.pos, cd.size, cd.delta))
+                    throw std::runtime_error("failed to read chunk");
+                switch (cd.type) {
+                case CacheChunkType::Asset: obj.asset = Asset::create(m_scene_buf); break;
+                case CacheChunkType::Entity: obj.entity = std::static_pointer_cast<Transform>(Entity::create(m_scene_buf)); break;
+                case CacheChunkType::Constraint: obj.constraint = Constraint::create(m_scene_buf); break;
+                default: break;
+                }
+                if (m_settings.keyframe_interval > 1 && obj.entity && obj.entity->getType() == Entity::Type::Mesh)
+                    obj.data = std::make_shared<RawVector<char>>(m_scene_buf.getBuffer());
+            }
+
+            if (obj.asset)
+                ret->assets.push_back(obj.asset);
+            if (obj.entity)
+                ret->entities.push_back(obj.entity);
+            if (obj.constraint)
+                ret->constraints.push_back(obj.constraint);
+            chunk_cache[cd.pos] = obj;
+        }
+        m_chunk_cache.swap(chunk_cache);
+        return ret;
     }
     catch (std::runtime_error& e) {
         msLogError("exception: %s\n", e.what());
-        m_last_scene = nullptr;
         return nullptr;
     }
 }
 
-ScenePtr ISceneCacheImpl::getByTime(float time, bool lerp)
+int ISceneCacheImpl::getFrameIndex(float time) const
 {
     if (m_descs.empty())
-        return ScenePtr();
-
+        return -1;
     if (time <= m_descs.front().time)
-        return getByIndex(0);
-    else if(time >= m_descs.back().time)
-        return getByIndex(m_descs.size() - 1);
-    else {
-        auto i = std::distance(m_descs.begin(),
+        return 0;
+    else if (time >= m_descs.back().time)
+        return (int)m_descs.size() - 1;
+    else
+        return (int)std::distance(m_descs.begin(),
             std::lower_bound(m_descs.begin(), m_descs.end(), time, [time](auto& a, float t) { return a.time < t; })) - 1;
-        if (lerp) {
-            m_scene1 = m_descs[i];
-            m_scene1.scene = getByIndex(i);
-            m_scene2 = m_descs[i + 1];
-            m_scene2.scene = getByIndex(i + 1);
-
-            float t = (time - m_scene1.time) / (m_scene2.time - m_scene1.time);
-            m_last_scene = Scene::create();
-            m_last_scene->lerp(*m_scene1.scene, *m_scene2.scene, t);
-            return m_last_scene;
+}
+
+ScenePtr ISceneCacheImpl::getCachedScene(size_t i)
+{
+    std::unique_lock<std::mutex> l(m_mutex);
+    auto ret = m_descs[i].scene;
+    if (ret) {
+        m_history.remove(i);
+        m_history.push_back(i);
+    }
+    return ret;
+}
+
+void ISceneCacheImpl::addCachedScene(size_t i, ScenePtr scene)
+{
+    if (!scene)
+        return;
+
+    std::unique_lock<std::mutex> l(m_mutex);
+    m_descs[i].scene = scene;
+    m_history.remove(i);
+    m_history.push_back(i);
+    while (m_history.size() > (size_t)m_isettings.max_history) {
+        m_descs[m_history.front()].scene.reset();
+        m_history.pop_front();
+    }
+}
+
+void ISceneCacheImpl::prefetchByIndex(size_t i)
+{
+    if (!m_prefetch_thread.joinable() || i >= m_descs.size())
+        return;
+
+    {
+        std::unique_lock<std::mutex> l(m_mutex);
+        bool backward = i < m_last_index;
+        m_last_index = i;
+
+        // only the latest request matters
+        m_prefetch_queue.clear();
+        int n = (int)m_descs.size();
+        for (int j = 0; j <= m_isettings.preload_length; ++j) {
+            int f = backward ? (int)i - j : (int)i + j;
+            if (f < 0 || f >= n)
+                break;
+            if (!m_descs[f].scene)
+                m_prefetch_queue.push_back(f);
         }
-        else {
-            return getByIndex(i);
+    }
+    m_prefetch_cond.notify_one();
+}
+
+void ISceneCacheImpl::prefetchByTime(float time, bool next, bool lerp)
+{
+    int i = getFrameIndex(time);
+    if (i < 0)
+        return;
+    if (next || lerp)
+        i = std::min(i + 1, (int)m_descs.size() - 1);
+    prefetchByIndex(i);
+}
+
+void ISceneCacheImpl::processPrefetch()
+{
+    for (;;) {
+        size_t i;
+        {
+            std::unique_lock<std::mutex> l(m_mutex);
+            m_prefetch_cond.wait(l, [this]() { return m_prefetch_stop || !m_prefetch_queue.empty(); });
+            if (m_prefetch_stop)
+                break;
+            i = m_prefetch_queue.front();
+            m_prefetch_queue.pop_front();
+            if (m_descs[i].scene)
+                continue;
         }
+
+        std::unique_lock<std::mutex> l(m_io_mutex);
+        if (!getCachedScene(i))
+            addCachedScene(i, loadScene(i, nullptr));
     }
 }
 
+ScenePtr ISceneCacheImpl::getByIndexImpl(size_t i)
+{
+    if (i >= m_descs.size())
+        return ScenePtr();
+
+    auto ret = getCachedScene(i);
+    if (!ret) {
+        std::unique_lock<std::mutex> l(m_io_mutex);
+        // the prefetch thread may have loaded it while waiting for the lock
+        ret = getCachedScene(i);
+        if (!ret) {
+            ret = loadScene(i, nullptr);
+            addCachedScene(i, ret);
+        }
+    }
+    return ret;
+}
+
+ScenePtr ISceneCacheImpl::getByIndex(size_t i)
+{
+    m_last_scene = getByIndexImpl(i);
+    prefetchByIndex(i);
+    return m_last_scene;
+}
+
+ScenePtr ISceneCacheImpl::getByIndex(size_t i, const std::vector<std::string>& paths)
+{
+    // partial scenes are not cached
+    std::unique_lock<std::mutex> l(m_io_mutex);
+    m_last_scene = loadScene(i, &paths);
+    return m_last_scene;
+}
 
-OSceneCacheFile::OSceneCacheFile(const char *path, const SceneCacheSettings& settings)
+ScenePtr ISceneCacheImpl::getByTime(float time, bool lerp)
+{
+    int i = getFrameIndex(time);
+    if (i < 0)
+        return ScenePtr();
+
+    if (lerp && i + 1 < (int)m_descs.size() && time > m_descs[i].time) {
+        // both frames are likely in the cache already
+        m_scene1 = m_descs[i];
+        m_scene1.scene = getByIndexImpl(i);
+        m_scene2 = m_descs[i + 1];
+        m_scene2.scene = getByIndexImpl(i + 1);
+        prefetchByIndex(i + 1);
+        if (!m_scene1.scene || !m_scene2.scene)
+            return ScenePtr();
+
+        float t = (time - m_scene1.time) / (m_scene2.time - m_scene1.time);
+        m_last_scene = Scene::create();
+        m_last_scene->settings = m_scene1.scene->settings;
+        m_last_scene->lerp(*m_scene1.scene, *m_scene2.scene, t);
+        return m_last_scene;
+    }
+    else {
+        return getByIndex(i);
+    }
+}
+
+
+OSceneCacheFile::OSceneCacheFile(const char *path, const SceneCacheSettings& settings, const OSceneCacheSettings& osettings)
 {
     auto ofs = std::make_shared<std::ofstream>();
     ofs->open(path, std::ios::binary);
     if (*ofs) {
-        prepare(ofs, settings);
+        prepare(ofs, settings, osettings);
     }
 }
 
-OSceneCache* OpenOSceneCacheFileRaw(const char *path, const SceneCacheSettings& settings)
+OSceneCache* OpenOSceneCacheFileRaw(const char *path, const SceneCacheSettings& settings, const OSceneCacheSettings& osettings)
 {
-    auto ret = new OSceneCacheFile(path, settings);
+    auto ret = new OSceneCacheFile(path, settings, osettings);
     if (ret->valid()) {
         return ret;
     }
@@ -269,24 +815,28 @@ OSceneCache* OpenOSceneCacheFileRaw(const char *path, const SceneCacheSettings&
         return nullptr;
     }
 }
-OSceneCachePtr OpenOSceneCacheFile(const char *path, const SceneCacheSettings& settings)
+OSceneCachePtr OpenOSceneCacheFile(const char *path, const SceneCacheSettings& settings, const OSceneCacheSettings& osettings)
 {
-    return OSceneCachePtr(OpenOSceneCacheFileRaw(path, settings));
+    return OSceneCachePtr(OpenOSceneCacheFileRaw(path, settings, osettings));
 }
 
 
-ISceneCacheFile::ISceneCacheFile(const char *path)
+ISceneCacheFile::ISceneCacheFile(const char *path, const ISceneCacheSettings& settings)
 {
+    if (prepare(path, settings) || m_mapped.valid())
+        return;
+
+    // mapping failed (e.g. not enough address space). fall back to stream.
     auto ifs = std::make_shared<std::ifstream>();
     ifs->open(path, std::ios::binary);
     if (*ifs) {
-        prepare(ifs);
+        prepare(ifs, settings);
     }
 }
 
-ISceneCache* OpenISceneCacheFileRaw(const char *path)
+ISceneCache* OpenISceneCacheFileRaw(const char *path, const ISceneCacheSettings& settings)
 {
-    auto ret = new ISceneCacheFile(path);
+    auto ret = new ISceneCacheFile(path, settings);
     if (ret->valid()) {
         return ret;
     }
@@ -295,9 +845,9 @@ ISceneCache* OpenISceneCacheFileRaw(const char *path)
         return nullptr;
     }
 }
-ISceneCachePtr OpenISceneCacheFile(const char *path)
+ISceneCachePtr OpenISceneCacheFile(const char *path, const ISceneCacheSettings& settings)
 {
-    return ISceneCachePtr(OpenISceneCacheFileRaw(path));
+    return ISceneCachePtr(OpenISceneCacheFileRaw(path, settings));
 }
 
 } // namespace ms
@@ -1,24 +1,100 @@
 #pragma once
+#include <thread>
+#include <deque>
+#include <condition_variable>
 #include "msSceneCache.h"
 #include "msEncoder.h"
+#include "msMisc.h"
 
 namespace ms {
 
+// file layout:
+//  CacheFileHeader
+//  ZSTD dictionary (CacheFileHeader::dictionary_size bytes)
+//  (CacheFileSceneHeader + frame record) * num frames
+//  CacheFileSceneHeader::terminator()
+//  CacheFileFrameEntry * num frames (frame table)
+//  CacheFileFooter
+//
+// the frame table and footer are written on close. files without them (old or not closed properly) are opened by scanning scene headers.
+//
+// frame record:
+//  encoded chunks that appeared first in this frame
+//  encoded CacheFrameIndex (index_size bytes)
+
 struct CacheFileHeader
 {
     char magic[4] = { 'M', 'S', 'S', 'C' };
     int version = msProtocolVersion;
     SceneCacheSettings settings;
+    uint64_t dictionary_size = 0;
 };
 
 struct CacheFileSceneHeader
 {
-    uint64_t size = 0;
+    uint64_t size = 0; // size of frame record
+    uint64_t index_size = 0; // size of encoded CacheFrameIndex at the end of frame record
     float time = 0.0f;
 
     static CacheFileSceneHeader terminator() { return CacheFileSceneHeader(); }
 };
 
+struct CacheFileFrameEntry
+{
+    uint64_t pos = 0; // position of frame record
+    uint64_t size = 0;
+    uint64_t index_size = 0;
+    float time = 0.0f;
+};
+
+struct CacheFileFooter
+{
+    char magic[4] = { 'M', 'S', 'S', 'F' };
+    uint32_t num_frames = 0;
+    uint64_t table_pos = 0; // position of the first CacheFileFrameEntry
+};
+
+enum class CacheChunkType
+{
+    Unknown,
+    Asset,
+    Entity,
+    Constraint,
+};
+
+// an encoded asset / entity / constraint.
+// chunks that didn't change from previous frame are not written again. desc points to the old one.
+// delta chunks are CacheDeltaHeader + encoded bitwise XOR of the serialized data and the base chunk's.
+struct CacheChunkDesc
+{
+    CacheChunkType type = CacheChunkType::Unknown;
+    std::string path; // entity / constraint path or asset name
+    uint64_t pos = 0; // absolute position in the file
+    uint64_t size = 0; // encoded size
+    bool delta = false;
+
+    void serialize(std::ostream& os) const;
+    void deserialize(std::istream& is);
+};
+msSerializable(CacheChunkDesc);
+
+struct CacheDeltaHeader
+{
+    uint64_t base_pos = 0;
+    uint64_t base_size = 0;
+    uint32_t base_delta = 0; // base is also a delta chunk
+};
+
+struct CacheFrameIndex
+{
+    SceneSettings settings;
+    std::vector<CacheChunkDesc> chunks;
+
+    void serialize(std::ostream& os) const;
+    void deserialize(std::istream& is);
+};
+msSerializable(CacheFrameIndex);
+
 
 class OSceneCacheImpl : public OSceneCache
 {
@@ -31,27 +107,76 @@ public:
     void flush() override;
     bool isWriting() override;
 
-    bool prepare(ostream_ptr ost, const SceneCacheSettings& settings);
+    bool prepare(ostream_ptr ost, const SceneCacheSettings& settings, const OSceneCacheSettings& osettings = OSceneCacheSettings());
     bool valid() const;
 
 protected:
-    void doWrite();
-
-    struct SceneDesc {
+    // frames go through 3 stages:
+    //  serialize & compress: on the task pool. any number of frames in parallel.
+    //  compare with the last chunks: in order, as it depends on previous frames.
+    //  write: in order, by whichever worker finished the next frame to write.
+    struct EncodedChunk {
+        CacheChunkType type = CacheChunkType::Unknown;
+        std::string path;
+        EntityPtr entity; // to check topology for delta encoding
+        std::shared_ptr<RawVector<char>> data; // serialized
+        std::shared_ptr<RawVector<char>> base; // data of the previous frame to make residual
+        RawVector<char> encoded;
+        bool changed = false;
+        bool delta = false;
+    };
+    struct ChunkHistory {
+        std::shared_ptr<RawVector<char>> data;
+        EntityPtr entity;
+        int delta_count = 0; // number of delta chunks since the last keyframe
+    };
+    struct FrameTask {
+        uint64_t seq = 0;
+        float time = 0.0f;
         ScenePtr scene;
-        float time;
+        SceneSettings settings;
+        std::vector<EncodedChunk> chunks;
     };
+    using FrameTaskPtr = std::shared_ptr<FrameTask>;
+    using ChunkKey = std::tuple<CacheChunkType, std::string>;
+
+    void encodeFrame(FrameTaskPtr task);
+    void writeFrames();
+    void writeHeader();
+    void writeFrame(FrameTask& task);
+    BufferEncoderPtr acquireEncoder();
+    void releaseEncoder(BufferEncoderPtr encoder);
 
     ostream_ptr m_ost = nullptr;
     SceneCacheSettings m_settings;
+    OSceneCacheSettings m_osettings;
+    uint64_t m_pos = 0;
 
+    // m_mutex guards sequence numbers, m_encoded_frames and m_encoders
     std::mutex m_mutex;
-    std::list<SceneDesc> m_queue;
-    std::future<void> m_task;
+    std::condition_variable m_cond;
+    uint64_t m_next_seq = 0; // seq of the next added frame
+    uint64_t m_compare_seq = 0; // seq of the frame allowed to access m_chunk_history
+    uint64_t m_write_seq = 0; // seq of the next frame to write
+    bool m_writing = false;
+    std::map<uint64_t, FrameTaskPtr> m_encoded_frames;
+    std::vector<BufferEncoderPtr> m_encoders; // idle ones. each worker needs its own
+    std::unique_ptr<mu::thread_pool> m_task_pool;
 
+    // last serialized data for each path. used to skip unchanged ones.
+    std::map<ChunkKey, ChunkHistory> m_chunk_history;
+    // trained from the first frame. fixed once the first frame is compared.
+    RawVector<char> m_dictionary;
+
+    // accessed only by the writer. header is written with the first frame as it contains the dictionary.
+    bool m_header_written = false;
     BufferEncoderPtr m_encoder;
     MemoryStream m_scene_buf;
     RawVector<char> m_encoded_buf;
+    RawVector<char> m_record_buf;
+    CacheFrameIndex m_index;
+    std::map<ChunkKey, CacheChunkDesc> m_chunk_descs; // last written chunk for each path
+    std::vector<CacheFileFrameEntry> m_frames;
 };
 
 
@@ -66,9 +191,13 @@ public:
     std::tuple<float, float> getTimeRange() const override;
     ScenePtr getByIndex(size_t i) override;
     ScenePtr getByTime(float t, bool lerp) override;
+    ScenePtr getByIndex(size_t i, const std::vector<std::string>& paths) override;
 
-    bool prepare(istream_ptr ist);
+    bool prepare(istream_ptr ist, const ISceneCacheSettings& settings);
+    // map the whole file and decode straight from it. returns false if mapping failed.
+    bool prepare(const char *path, const ISceneCacheSettings& settings);
     bool valid() const;
+    // decode frames ahead of i in play direction on the background thread
     void prefetchByIndex(size_t i);
     void prefetchByTime(float t, bool next, bool lerp);
 
@@ -76,15 +205,51 @@ protected:
     struct SceneDesc {
         uint64_t pos = 0;
         uint64_t size = 0;
+        uint64_t index_size = 0;
         float time = 0.0f;
         ScenePtr scene;
     };
 
+    // decoded chunk. kept while the last loaded frame refers it, to skip decoding unchanged ones.
+    struct ChunkObject {
+        AssetPtr asset;
+        TransformPtr entity;
+        ConstraintPtr constraint;
+        std::shared_ptr<RawVector<char>> data; // serialized data. kept only for meshes that can be base of delta chunks
+    };
+
+    bool prepareImpl(const ISceneCacheSettings& settings);
+    bool readFrameTable();
+    void scanFrames();
+    // returns pointer to size bytes at pos (valid until the next call) or nullptr if out of range
+    const char* readBuffer(uint64_t pos, uint64_t size);
+    ScenePtr loadScene(size_t i, const std::vector<std::string> *paths);
+    bool readChunk(uint64_t pos, uint64_t size, bool delta = false);
+    // decode into dst. delta chunks are resolved back to the keyframe.
+    bool decodeChunk(uint64_t pos, uint64_t size, bool delta, RawVector<char>& dst);
+    int getFrameIndex(float time) const;
+    ScenePtr getByIndexImpl(size_t i);
+    ScenePtr getCachedScene(size_t i);
+    void addCachedScene(size_t i, ScenePtr scene);
+    void processPrefetch();
+
     istream_ptr m_ist;
+    MappedFile m_mapped; // used instead of m_ist if valid
+    uint64_t m_file_size = 0;
+    uint64_t m_frames_pos = 0; // position of the first CacheFileSceneHeader
     SceneCacheSettings m_settings;
+    ISceneCacheSettings m_isettings;
 
-    std::mutex m_mutex;
+    // m_mutex guards m_descs[].scene, m_history and prefetch queue. m_io_mutex guards reading and decoding.
+    std::mutex m_mutex, m_io_mutex;
     std::vector<SceneDesc> m_descs;
+    std::list<size_t> m_history; // LRU. most recent one is at back
+    size_t m_last_index = 0;
+
+    std::thread m_prefetch_thread;
+    std::condition_variable m_prefetch_cond;
+    std::deque<size_t> m_prefetch_queue;
+    bool m_prefetch_stop = false;
 
     float m_last_time = -1.0f;
     SceneDesc m_scene1, m_scene2;
@@ -93,6 +258,7 @@ protected:
     BufferEncoderPtr m_encoder;
     MemoryStream m_scene_buf;
     RawVector<char> m_encoded_buf, m_tmp_buf;
+    std::map<uint64_t, ChunkObject> m_chunk_cache;
 };
 
 
@@ -100,14 +266,14 @@ protected:
 class OSceneCacheFile : public OSceneCacheImpl
 {
 public:
-    OSceneCacheFile(const char *path, const SceneCacheSettings& settings);
+    OSceneCacheFile(const char *path, const SceneCacheSettings& settings, const OSceneCacheSettings& osettings);
 };
 
 
 class ISceneCacheFile : public ISceneCacheImpl
 {
 public:
-    ISceneCacheFile(const char *path);
+    ISceneCacheFile(const char *path, const ISceneCacheSettings& settings);
 };
 
 } // namespace ms
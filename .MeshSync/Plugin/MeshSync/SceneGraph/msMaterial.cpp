@@ -18,7 +18,10 @@ void MaterialProperty::deserialize(std::istream& is)
 }
 uint64_t MaterialProperty::checksum() const
 {
-    return mu::SumInt32(data.data(), data.size());
+    uint64_t ret = csum(name);
+    ret = mu::HashCombine(ret, csum(type));
+    ret = mu::HashCombine(ret, mu::Hash64(data.data(), data.size()));
+    return ret;
 }
 bool MaterialProperty::operator==(const MaterialProperty& v) const
 {
@@ -158,7 +161,7 @@ void MaterialKeyword::deserialize(std::istream& is)
 
 uint64_t MaterialKeyword::checksum() const
 {
-    return uint64_t(value);
+    return mu::HashCombine(csum(name), csum(value));
 }
 bool MaterialKeyword::operator==(const MaterialKeyword& v) const
 {
@@ -1,6 +1,7 @@
 #include "pch.h"
 #include "msSceneGraph.h"
 #include "msMesh.h"
+#include "SceneCache/msEncoder.h"
 
 namespace ms {
 
@@ -162,20 +163,171 @@ void BoneData::applyScaleFactor(float scale)
 #define EachVertexProperty(Body)\
     Body(points) Body(normals) Body(tangents) Body(uv0) Body(uv1) Body(colors) Body(velocities) Body(counts) Body(indices) Body(material_ids)
 
+template<class T>
+static inline bool SameArray(const RawVector<T>& a, const RawVector<T>& b)
+{
+    return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), sizeof(T) * a.size()) == 0);
+}
+
+#define EachDeltaProperty(Body)\
+    Body(points) Body(normals) Body(tangents) Body(uv0) Body(uv1) Body(colors) Body(velocities)
+
+template<class T>
+bool VertexDelta<T>::build(const RawVector<T>& base, const RawVector<T>& v)
+{
+    clear();
+    if (base.size() != v.size())
+        return false;
+    if (SameArray(base, v))
+        return true;
+
+    // close ranges are merged. a few unchanged elements are cheaper than a new range.
+    const int merge_gap = 8;
+    const int n = (int)v.size();
+    auto add_range = [&](int begin, int end) {
+        ranges.push_back(begin);
+        ranges.push_back(end - begin);
+        values.insert(values.end(), v.data() + begin, v.data() + end);
+    };
+    int begin = -1, last = -1;
+    for (int i = 0; i < n; ++i) {
+        if (std::memcmp(&base[i], &v[i], sizeof(T)) == 0)
+            continue;
+        if (begin < 0)
+            begin = i;
+        else if (i - last > merge_gap) {
+            add_range(begin, last + 1);
+            begin = i;
+        }
+        last = i;
+    }
+    if (begin >= 0)
+        add_range(begin, last + 1);
+    return true;
+}
+
+template<class T>
+bool VertexDelta<T>::apply(RawVector<T>& dst) const
+{
+    size_t pos = 0;
+    size_t num_ranges = ranges.size() / 2;
+    for (size_t ri = 0; ri < num_ranges; ++ri) {
+        int offset = ranges[ri * 2 + 0];
+        int count = ranges[ri * 2 + 1];
+        if (offset < 0 || count < 0 || (size_t)offset + count > dst.size() || pos + count > values.size())
+            return false;
+        std::memcpy(dst.data() + offset, values.data() + pos, sizeof(T) * count);
+        pos += count;
+    }
+    return true;
+}
+
+template<class T>
+void VertexDelta<T>::serialize(std::ostream& os) const
+{
+    write(os, ranges);
+    write(os, values);
+}
+
+template<class T>
+void VertexDelta<T>::deserialize(std::istream& is)
+{
+    read(is, ranges);
+    read(is, values);
+}
+
+template<class T>
+void VertexDelta<T>::clear()
+{
+    ranges.clear();
+    values.clear();
+}
+
+template<class T>
+bool VertexDelta<T>::empty() const
+{
+    return ranges.empty();
+}
+
+template struct VertexDelta<float2>;
+template struct VertexDelta<float3>;
+template struct VertexDelta<float4>;
+
+
+void MeshDelta::serialize(std::ostream& os) const
+{
+    write(os, transform);
+    write(os, base_checksum);
+    write(os, checksum);
+#define Body(A) A.serialize(os);
+    EachDeltaProperty(Body);
+#undef Body
+}
+
+void MeshDelta::deserialize(std::istream& is)
+{
+    read(is, transform);
+    read(is, base_checksum);
+    read(is, checksum);
+#define Body(A) A.deserialize(is);
+    EachDeltaProperty(Body);
+#undef Body
+}
+
+void MeshDelta::clear()
+{
+    transform.reset();
+    base_checksum = checksum = 0;
+#define Body(A) A.clear();
+    EachDeltaProperty(Body);
+#undef Body
+}
+
+size_t MeshDelta::getDataSize() const
+{
+    size_t ret = 0;
+#define Body(A) ret += A.ranges.size() * sizeof(int) + A.values.size() * sizeof(A.values[0]);
+    EachDeltaProperty(Body);
+#undef Body
+    return ret;
+}
+
+
 Mesh::Mesh() {}
 Mesh::~Mesh() {}
 Entity::Type Mesh::getType() const { return Type::Mesh; }
 bool Mesh::isGeometry() const { return true; }
 
+// Body(member, encode setting, encoding)
+#define EachEncodableVertexProperty(Body)\
+    Body(points, quantize_points, VertexArrayEncoding::Bounded16)\
+    Body(normals, quantize_normals, VertexArrayEncoding::S10x3)\
+    Body(tangents, quantize_tangents, VertexArrayEncoding::S10x3)\
+    Body(uv0, quantize_uv, VertexArrayEncoding::Bounded16)\
+    Body(uv1, quantize_uv, VertexArrayEncoding::Bounded16)\
+    Body(colors, quantize_colors, VertexArrayEncoding::Bounded8)\
+    Body(velocities, quantize_velocities, VertexArrayEncoding::Bounded16)
+#define EachEncodableIndexProperty(Body)\
+    Body(counts) Body(indices) Body(material_ids)
+
 void Mesh::serialize(std::ostream& os) const
+{
+    serialize(os, encode_settings);
+}
+
+void Mesh::serialize(std::ostream& os, const MeshEncodeSettings& es) const
 {
     super::serialize(os);
 
     write(os, flags);
+    write(os, es);
     write(os, refine_settings);
 
-#define Body(A) write(os, A);
-    EachVertexProperty(Body);
+#define Body(A, S, E) if (es.S) EncodeVertexArray(os, A, E); else write(os, A);
+    EachEncodableVertexProperty(Body);
+#undef Body
+#define Body(A) if (es.pack_indices) EncodeVertexArray(os, A); else write(os, A);
+    EachEncodableIndexProperty(Body);
 #undef Body
     write(os, root_bone);
     write(os, bones);
@@ -187,10 +339,15 @@ void Mesh::deserialize(std::istream& is)
     super::deserialize(is);
 
     read(is, flags);
+    read(is, encode_settings);
     read(is, refine_settings);
 
-#define Body(A) read(is, A);
-    EachVertexProperty(Body);
+    auto& es = encode_settings;
+#define Body(A, S, E) if (es.S) DecodeVertexArray(is, A); else read(is, A);
+    EachEncodableVertexProperty(Body);
+#undef Body
+#define Body(A) if (es.pack_indices) DecodeVertexArray(is, A); else read(is, A);
+    EachEncodableIndexProperty(Body);
 #undef Body
     read(is, root_bone);
     read(is, bones);
@@ -206,6 +363,7 @@ void Mesh::clear()
     super::clear();
 
     flags = { 0 };
+    encode_settings = { 0 };
     refine_settings = MeshRefineSettings();
 
 #define Body(A) vclear(A);
@@ -227,8 +385,14 @@ void Mesh::clear()
 uint64_t Mesh::hash() const
 {
     uint64_t ret = super::hash();
+    // quantized arrays are dequantized on the receiver and don't match the sender's bit by bit.
+    // only their sizes can be validated.
+    auto& es = encode_settings;
+#define Body(A, S, E) ret += es.S ? (uint64_t)A.size() : vhash(A);
+    EachEncodableVertexProperty(Body);
+#undef Body
 #define Body(A) ret += vhash(A);
-    EachVertexProperty(Body);
+    EachEncodableIndexProperty(Body);
 #undef Body
     if (flags.has_bones) {
         for(auto& b : bones)
@@ -246,6 +410,9 @@ uint64_t Mesh::hash() const
     return ret;
 }
 
+#undef EachEncodableIndexProperty
+#undef EachEncodableVertexProperty
+
 uint64_t Mesh::checksumGeom() const
 {
     uint64_t ret = 0;
@@ -293,7 +460,7 @@ bool Mesh::lerp(const Entity& s1_, const Entity& s2_, float t)
     auto& s1 = static_cast<const Mesh&>(s1_);
     auto& s2 = static_cast<const Mesh&>(s2_);
 
-    if (s1.points.size() != s2.points.size() || s1.indices.size() != s2.indices.size())
+    if (!s1.isTopologyCompatible(s2))
         return false;
 #define DoLerp(N) N.resize_discard(s1.N.size()); Lerp(N.data(), s1.N.data(), s2.N.data(), N.size(), t)
     DoLerp(points);
@@ -319,6 +486,52 @@ EntityPtr Mesh::clone()
     return ret;
 }
 
+bool Mesh::isTopologyCompatible(const Mesh& v) const
+{
+    return points.size() == v.points.size() && indices.size() == v.indices.size();
+}
+
+bool Mesh::diff(const Mesh& base, MeshDelta& dst) const
+{
+    dst.clear();
+    if (!isTopologyCompatible(base) ||
+        (uint32_t&)flags != (uint32_t&)base.flags ||
+        refine_settings.checksum() != base.refine_settings.checksum() ||
+        !SameArray(counts, base.counts) ||
+        !SameArray(indices, base.indices) ||
+        !SameArray(material_ids, base.material_ids) ||
+        root_bone != base.root_bone ||
+        !bones.empty() || !base.bones.empty() ||
+        !blendshapes.empty() || !base.blendshapes.empty())
+        return false;
+
+    size_t whole_size = 0;
+#define Body(A) if (!dst.A.build(base.A, A)) return false; whole_size += A.size() * sizeof(A[0]);
+    EachDeltaProperty(Body);
+#undef Body
+
+    // not worth it if most of vertices changed
+    if (dst.getDataSize() * 2 > whole_size)
+        return false;
+
+    auto t = Transform::create();
+    static_cast<Transform&>(*t) = *this;
+    dst.transform = t;
+    return true;
+}
+
+bool Mesh::patch(const MeshDelta& delta)
+{
+#define Body(A) if (!delta.A.apply(A)) return false;
+    EachDeltaProperty(Body);
+#undef Body
+    if (delta.transform)
+        static_cast<Transform&>(*this) = *delta.transform;
+    return true;
+}
+
+#undef EachDeltaProperty
+
 void Mesh::convertHandedness(bool x, bool yz)
 {
     if (!x && !yz) return;
@@ -404,19 +617,25 @@ void Mesh::refine(const MeshRefineSettings& mrs)
             setupBoneWeightsVariable();
     }
 
+    // vertex to face connection. built on first use and shared by the following steps.
+    // steps that change topology must clear it.
+    mu::MeshConnectionInfo connection;
+
     // normals
     bool flip_normals = mrs.flags.flip_normals ^ mrs.flags.flip_faces;
     if (mrs.flags.gen_normals || (mrs.flags.gen_normals_with_smooth_angle && mrs.smooth_angle >= 180.0f)) {
         GenerateNormalsPoly(normals, points, counts, indices, flip_normals);
     }
     else if (mrs.flags.gen_normals_with_smooth_angle) {
-        GenerateNormalsWithSmoothAngle(normals, points, counts, indices, mrs.smooth_angle, flip_normals);
+        GenerateNormalsWithSmoothAngle(normals, points, counts, indices, mrs.smooth_angle, flip_normals, connection);
     }
 
     // generate back faces
     // this must be after generating normals.
-    if (mrs.flags.make_double_sided)
+    if (mrs.flags.make_double_sided) {
         makeDoubleSided();
+        connection.clear();
+    }
 
     size_t num_indices_old = indices.size();
     size_t num_points_old = points.size();
@@ -431,7 +650,7 @@ void Mesh::refine(const MeshRefineSettings& mrs)
     refiner.points = points;
     refiner.indices = indices;
     refiner.counts = counts;
-    refiner.buildConnection();
+    refiner.connection.swap(connection);
 
     if (normals.size() == indices.size())
         refiner.addExpandedAttribute<float3>(normals, tmp_normals, remap_normals);
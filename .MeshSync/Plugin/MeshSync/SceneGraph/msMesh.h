@@ -24,6 +24,18 @@ struct MeshDataFlags
     uint32_t apply_trs : 1;
 };
 
+// vertex streams written in compact forms by Mesh::serialize(). lossy except pack_indices.
+struct MeshEncodeSettings
+{
+    uint32_t quantize_points : 1; // 16 bit per component in bounds
+    uint32_t quantize_normals : 1; // 10 bit per component
+    uint32_t quantize_tangents : 1; // 10 bit per component
+    uint32_t quantize_uv : 1; // 16 bit per component in bounds
+    uint32_t quantize_colors : 1; // 8 bit per component in bounds
+    uint32_t quantize_velocities : 1; // 16 bit per component in bounds
+    uint32_t pack_indices : 1; // counts, indices and material ids in 8 or 16 bit if possible
+};
+
 struct MeshRefineFlags
 {
     uint32_t split : 1;
@@ -167,6 +179,47 @@ public:
 msSerializable(BoneData);
 msDeclPtr(BoneData);
 
+// changed ranges of a vertex array. made by Mesh::diff() and applied by Mesh::patch().
+template<class T>
+struct VertexDelta
+{
+    RawVector<int> ranges; // offset & count pairs
+    RawVector<T> values; // new values of all ranges
+
+    // return false if sizes differ (can't be a delta)
+    bool build(const RawVector<T>& base, const RawVector<T>& v);
+    // return false if ranges are out of dst
+    bool apply(RawVector<T>& dst) const;
+    void serialize(std::ostream& os) const;
+    void deserialize(std::istream& is);
+    void clear();
+    bool empty() const;
+};
+
+// difference of vertex arrays between two versions of a mesh that share topology.
+// sent instead of the whole mesh when only some vertices changed (sculpting etc).
+struct MeshDelta
+{
+    TransformPtr transform; // transform part of the mesh. small enough to send always
+    uint64_t base_checksum = 0; // checksumGeom() of the mesh this applies to
+    uint64_t checksum = 0; // checksumGeom() of the result
+
+    VertexDelta<float3> points;
+    VertexDelta<float3> normals;
+    VertexDelta<float4> tangents;
+    VertexDelta<float2> uv0, uv1;
+    VertexDelta<float4> colors;
+    VertexDelta<float3> velocities;
+
+    void serialize(std::ostream& os) const;
+    void deserialize(std::istream& is);
+    void clear();
+    // size of changed values in bytes
+    size_t getDataSize() const;
+};
+msSerializable(MeshDelta);
+msDeclPtr(MeshDelta);
+
 class Mesh : public Transform
 {
 using super = Transform;
@@ -174,6 +227,7 @@ public:
     // serializable fields
 
     MeshDataFlags      flags = { 0 };
+    MeshEncodeSettings encode_settings = { 0 };
     MeshRefineSettings refine_settings;
 
     RawVector<float3> points;
@@ -210,12 +264,19 @@ public:
     Type getType() const override;
     bool isGeometry() const override;
     void serialize(std::ostream& os) const override;
+    void serialize(std::ostream& os, const MeshEncodeSettings& es) const;
     void deserialize(std::istream& is) override;
     void clear() override;
     uint64_t hash() const override;
     uint64_t checksumGeom() const override;
     bool lerp(const Entity& src1, const Entity& src2, float t) override;
     EntityPtr clone() override;
+    // vertex and index counts match. required by lerp() and delta encoding of scene caches.
+    bool isTopologyCompatible(const Mesh& v) const;
+    // make delta from base. return false if anything other than vertex values differs (needs whole mesh).
+    // checksums are left to the caller.
+    bool diff(const Mesh& base, MeshDelta& dst) const;
+    bool patch(const MeshDelta& delta);
 
     void convertHandedness(bool x, bool yz) override;
     void applyScaleFactor(float scale) override;
@@ -46,6 +46,32 @@ void Scene::deserialize(std::istream& is)
     }
 }
 
+void Scene::deserialize(std::istream& is, const std::function<void(TransformPtr&)>& on_entity)
+{
+    uint64_t validation_hash;
+    read(is, validation_hash);
+    read(is, settings);
+    read(is, assets);
+
+    uint64_t h = 0;
+    for (auto& a : assets)
+        h += a->hash();
+
+    uint32_t num_entities = 0;
+    is.read((char*)&num_entities, 4);
+    entities.resize(num_entities);
+    for (auto& e : entities) {
+        read(is, e);
+        h += e->hash();
+        on_entity(e);
+    }
+
+    read(is, constraints);
+    if (validation_hash != h) {
+        throw std::runtime_error("scene hash doesn't match");
+    }
+}
+
 void Scene::clear()
 {
     settings = SceneSettings();
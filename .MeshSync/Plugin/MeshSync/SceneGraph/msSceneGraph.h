@@ -51,6 +51,9 @@ public:
 
     void serialize(std::ostream& os) const;
     void deserialize(std::istream& is); // throw
+    // on_entity is called for each entity right after it is read, before the rest of the stream is read.
+    // entities can be modified in it (e.g. handed to other threads) as the hash is validated before that.
+    void deserialize(std::istream& is, const std::function<void(TransformPtr&)>& on_entity); // throw
     void clear();
     uint64_t hash() const;
     void lerp(const Scene& src1, const Scene& src2, float t);
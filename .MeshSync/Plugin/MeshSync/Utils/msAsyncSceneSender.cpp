@@ -4,6 +4,27 @@
 
 namespace ms {
 
+// approximate size of serialized data. used to order and batch geometries.
+static size_t EstimateSize(const Transform& geom)
+{
+    if (geom.getType() != Entity::Type::Mesh)
+        return sizeof(Transform);
+
+    auto& mesh = static_cast<const Mesh&>(geom);
+    size_t ret = sizeof(Mesh);
+#define Body(A) ret += mesh.A.size() * sizeof(mesh.A[0]);
+    Body(points) Body(normals) Body(tangents) Body(uv0) Body(uv1) Body(colors) Body(velocities)
+    Body(counts) Body(indices) Body(material_ids)
+#undef Body
+    for (auto& bone : mesh.bones)
+        ret += bone->weights.size() * sizeof(float);
+    for (auto& bs : mesh.blendshapes) {
+        for (auto& frame : bs->frames)
+            ret += (frame->points.size() + frame->normals.size() + frame->tangents.size()) * sizeof(float3);
+    }
+    return ret;
+}
+
 AsyncSceneSender::AsyncSceneSender(int sid)
 {
     if (sid == InvalidID) {
@@ -57,6 +78,68 @@ void AsyncSceneSender::kick()
     m_future = std::async(std::launch::async, [this]() { send(); });
 }
 
+bool AsyncSceneSender::sendParallel(Client& client, size_t n, const std::function<bool(Client&, size_t)>& body, std::string& error)
+{
+    std::atomic_size_t next{ 0 };
+    std::atomic_bool failed{ false };
+    std::mutex mutex;
+    auto process = [&](Client& c) {
+        while (!failed) {
+            size_t i = next++;
+            if (i >= n)
+                break;
+            if (!body(c, i)) {
+                failed = true;
+                std::unique_lock<std::mutex> lock(mutex);
+                if (error.empty())
+                    error = c.getErrorMessage();
+            }
+        }
+    };
+
+    // the scene is fenced by session id, not by connection. so messages can be sent with other connections.
+    size_t num_connections = std::min(n, (size_t)std::max(max_connections, 1));
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < num_connections; ++i) {
+        threads.emplace_back([&]() {
+            Client c(client_settings);
+            c.beginSession();
+            process(c);
+            c.endSession();
+        });
+    }
+    process(client);
+    for (auto& t : threads)
+        t.join();
+    return !failed;
+}
+
+void AsyncSceneSender::setSentMesh(const std::string& path, MeshPtr mesh, uint64_t checksum)
+{
+    auto it = m_sent_meshes.find(path);
+    if (it != m_sent_meshes.end()) {
+        m_sent_lru.erase(it->second.lru);
+        if (!mesh)
+            m_sent_meshes.erase(it);
+    }
+    if (!mesh)
+        return;
+
+    m_sent_lru.push_front(path);
+    auto& dst = m_sent_meshes[path];
+    dst.mesh = mesh;
+    dst.checksum = checksum;
+    dst.lru = m_sent_lru.begin();
+
+    // discard least recently used ones
+    if (max_sent_meshes > 0) {
+        while ((int)m_sent_meshes.size() > max_sent_meshes) {
+            m_sent_meshes.erase(m_sent_lru.back());
+            m_sent_lru.pop_back();
+        }
+    }
+}
+
 void AsyncSceneSender::send()
 {
     if (on_prepare)
@@ -72,7 +155,10 @@ void AsyncSceneSender::send()
     auto append = [](auto& dst, auto& src) { dst.insert(dst.end(), src.begin(), src.end()); };
 
     bool succeeded = true;
+    std::string error_message;
     ms::Client client(client_settings);
+    // reuse one connection for the whole scene (SceneBegin ... SceneEnd)
+    client.beginSession();
 
     auto setup_message = [this](ms::Message& mes) {
         mes.session_id = session_id;
@@ -103,18 +189,20 @@ void AsyncSceneSender::send()
 
     // textures
     if (!textures.empty()) {
-        for (auto& tex : textures) {
-            ms::SetMessage mes;
+        std::vector<ms::SetMessage> messages(textures.size());
+        for (size_t i = 0; i < textures.size(); ++i) {
+            auto& mes = messages[i];
             setup_message(mes);
             mes.scene.settings = scene_settings;
-            mes.scene.assets = { tex };
-            succeeded = succeeded && client.send(mes);
-            if (!succeeded)
-                goto cleanup;
-        };
+            mes.scene.assets = { textures[i] };
+        }
+        succeeded = sendParallel(client, messages.size(),
+            [&](ms::Client& c, size_t i) { return c.send(messages[i]); }, error_message);
+        if (!succeeded)
+            goto cleanup;
     }
 
-    // materials and non-geometry objects
+    // materials and non-geometry objects. sent after textures as materials refer them.
     if (!materials.empty() || !transforms.empty()) {
         ms::SetMessage mes;
         setup_message(mes);
@@ -128,15 +216,121 @@ void AsyncSceneSender::send()
 
     // geometries
     if (!geometries.empty()) {
-        for (auto& geom : geometries) {
-            ms::SetMessage mes;
+        struct GeometryRecord
+        {
+            TransformPtr geom;
+            uint64_t checksum = 0;
+            size_t size = 0;
+            ms::DeltaMessage delta;
+            bool can_be_base = false; // can be a base of deltas
+            bool has_delta = false;
+            bool sent_as_delta = false;
+            bool succeeded = false;
+            bool retained = false; // the server keeps it as a base of deltas
+        };
+
+        int num_geometries = (int)geometries.size();
+        std::vector<GeometryRecord> records(num_geometries);
+        mu::parallel_for(0, num_geometries, [&](int gi) {
+            auto& rec = records[gi];
+            rec.geom = geometries[gi];
+            rec.size = EstimateSize(*rec.geom);
+            if (!use_geometry_delta || rec.geom->getType() != Entity::Type::Mesh)
+                return;
+
+            auto& mesh = static_cast<Mesh&>(*rec.geom);
+            // quantized data differ on the server. skinned meshes are not supported by Mesh::diff().
+            if ((uint32_t&)mesh.encode_settings != 0 || !mesh.bones.empty() || !mesh.blendshapes.empty())
+                return;
+            rec.can_be_base = true;
+            rec.checksum = mesh.checksumGeom();
+
+            auto it = m_sent_meshes.find(mesh.path);
+            if (it != m_sent_meshes.end() && mesh.diff(*it->second.mesh, rec.delta.delta)) {
+                rec.delta.scene_settings = scene_settings;
+                rec.delta.delta.base_checksum = it->second.checksum;
+                rec.delta.delta.checksum = rec.checksum;
+                rec.has_delta = true;
+            }
+        });
+
+        // deltas. rejected if the server doesn't have the base. the whole mesh is sent in that case.
+        std::vector<GeometryRecord*> deltas;
+        for (auto& rec : records) {
+            if (rec.has_delta) {
+                setup_message(rec.delta);
+                deltas.push_back(&rec);
+            }
+        }
+        sendParallel(client, deltas.size(), [&](ms::Client& c, size_t i) {
+            auto& rec = *deltas[i];
+            // the server patches its base. it keeps it as the base of the next delta.
+            rec.succeeded = rec.sent_as_delta = rec.retained = c.send(rec.delta);
+            return true;
+        }, error_message);
+
+        // whole meshes. larger ones first to keep all connections busy until the end.
+        // small ones are packed into one message up to geometry_batch_size.
+        std::vector<GeometryRecord*> remaining;
+        for (auto& rec : records) {
+            if (!rec.succeeded)
+                remaining.push_back(&rec);
+        }
+        std::stable_sort(remaining.begin(), remaining.end(),
+            [](const GeometryRecord *a, const GeometryRecord *b) { return a->size > b->size; });
+
+        std::vector<std::vector<GeometryRecord*>> batches;
+        size_t batch_size = 0;
+        for (auto *rec : remaining) {
+            if (batches.empty() || batch_size + rec->size > geometry_batch_size) {
+                batches.push_back({});
+                batch_size = 0;
+            }
+            batches.back().push_back(rec);
+            batch_size += rec->size;
+        }
+
+        std::vector<ms::SetMessage> messages(batches.size());
+        for (size_t bi = 0; bi < batches.size(); ++bi) {
+            auto& mes = messages[bi];
             setup_message(mes);
             mes.scene.settings = scene_settings;
-            mes.scene.entities = { geom };
-            succeeded = succeeded && client.send(mes);
-            if (!succeeded)
-                goto cleanup;
-        };
+            mes.use_delta = use_geometry_delta;
+            for (auto *rec : batches[bi])
+                mes.scene.entities.push_back(rec->geom);
+        }
+        succeeded = sendParallel(client, messages.size(), [&](ms::Client& c, size_t bi) {
+            std::vector<std::string> retained;
+            if (!c.send(messages[bi], retained))
+                return false;
+            std::sort(retained.begin(), retained.end());
+            for (auto *rec : batches[bi]) {
+                rec->succeeded = true;
+                rec->retained = rec->can_be_base && std::binary_search(retained.begin(), retained.end(), rec->geom->path);
+            }
+            return true;
+        }, error_message);
+
+        // keep bases of only ones the server retains. patched in place if sent as a delta, copied otherwise.
+        for (auto& rec : records) {
+            auto& path = rec.geom->path;
+            if (!rec.retained) {
+                setSentMesh(path, nullptr, 0);
+                continue;
+            }
+
+            MeshPtr base;
+            if (rec.sent_as_delta) {
+                auto it = m_sent_meshes.find(path);
+                if (it != m_sent_meshes.end() && it->second.mesh->patch(rec.delta.delta))
+                    base = it->second.mesh;
+            }
+            if (!base)
+                base = std::static_pointer_cast<Mesh>(rec.geom->clone());
+            setSentMesh(path, base, rec.checksum);
+        }
+        if (!succeeded)
+            goto cleanup;
     }
 
     // animations
@@ -156,6 +350,8 @@ void AsyncSceneSender::send()
         setup_message(mes);
         mes.entities = deleted_entities;
         mes.materials = deleted_materials;
+        for (auto& id : deleted_entities)
+            setSentMesh(id.name, nullptr, 0);
         succeeded = succeeded && client.send(mes);
         if (!succeeded)
             goto cleanup;
@@ -170,6 +366,10 @@ void AsyncSceneSender::send()
     }
 
 cleanup:
+    client.endSession();
+    if (!succeeded)
+        m_error_message = !error_message.empty() ? error_message : client.getErrorMessage();
+
     if (succeeded) {
         if (on_success)
             on_success();
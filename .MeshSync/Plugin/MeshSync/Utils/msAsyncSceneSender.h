@@ -1,5 +1,7 @@
 #pragma once
 
+#include <list>
+#include <map>
 #include "../msClient.h"
 
 namespace ms {
@@ -24,6 +26,16 @@ public:
 
     std::function<void()> on_prepare, on_success, on_error, on_complete;
 
+    // send only changed vertices of meshes that were sent before (see DeltaMessage)
+    bool use_geometry_delta = true;
+    // bases of deltas kept on this side. least recently used ones are discarded beyond this. 0: unlimited
+    // larger than ServerSettings::max_retained_meshes only wastes memory.
+    int max_sent_meshes = 1024;
+    // number of connections to send textures and geometries in parallel
+    int max_connections = 4;
+    // geometries are packed into messages up to this size (approximately, in bytes). larger ones are sent alone.
+    size_t geometry_batch_size = 4 * 1024 * 1024;
+
 
     AsyncSceneSender(int session_id = InvalidID);
     ~AsyncSceneSender();
@@ -35,9 +47,24 @@ public:
 
 private:
     void send();
+    // call body(client, i) for each i in [0, n) with up to max_connections connections. client is used as one of them.
+    // stops and returns false if body() returned false. error has the error message in that case.
+    bool sendParallel(Client& client, size_t n, const std::function<bool(Client&, size_t)>& body, std::string& error);
+
+    // last sent meshes that the server retains. base of deltas.
+    struct SentMesh
+    {
+        MeshPtr mesh;
+        uint64_t checksum = 0;
+        std::list<std::string>::iterator lru;
+    };
+    // null mesh erases the entry
+    void setSentMesh(const std::string& path, MeshPtr mesh, uint64_t checksum);
 
     std::future<void> m_future;
     std::string m_error_message;
+    std::map<std::string, SentMesh> m_sent_meshes;
+    std::list<std::string> m_sent_lru; // paths of m_sent_meshes. most recently used first
 };
 
 } // namespace ms
@@ -3,6 +3,17 @@
 
 namespace ms {
 
+static inline uint64_t PathHash(const std::string& path)
+{
+    return mu::Hash64(path.data(), path.size());
+}
+
+// records are not ordered. sort results by path to keep parents before children.
+static void SortByPath(std::vector<TransformPtr>& v)
+{
+    std::sort(v.begin(), v.end(), [](const TransformPtr& a, const TransformPtr& b) { return a->path < b->path; });
+}
+
 EntityManager::EntityManager()
 {
 }
@@ -14,66 +25,64 @@ EntityManager::~EntityManager()
 
 bool EntityManager::empty() const
 {
-    return m_records.empty();
+    for (auto& shard : m_shards) {
+        if (!shard.indices.empty())
+            return false;
+    }
+    return true;
 }
 
 void EntityManager::clear()
 {
-    waitTasks();
-    m_records.clear();
-    m_deleted.clear();
+    clearEntityRecords();
+    clearDeleteRecords();
 }
 void EntityManager::clearEntityRecords()
 {
     waitTasks();
-    m_records.clear();
+    for (auto& shard : m_shards) {
+        shard.indices.clear();
+        shard.records.clear();
+        shard.vacant.clear();
+    }
 }
 void EntityManager::clearDeleteRecords()
 {
     waitTasks();
+    std::unique_lock<std::mutex> lock(m_deleted_mutex);
     m_deleted.clear();
+    m_deleted_indices.clear();
+    m_num_deleted = 0;
 }
 
 
 bool EntityManager::erase(const std::string& path)
 {
-    auto it = m_records.find(path);
-    if (it != m_records.end()) {
-        it->second.waitTask();
-        m_records.erase(it);
-        m_deleted.push_back({ path, InvalidID });
-        return true;
-    }
-    return false;
+    return erase(Identifier(path, InvalidID));
 }
 
 bool EntityManager::erase(int id)
 {
     if (id == InvalidID)
         return false;
-    auto it = std::find_if(m_records.begin(), m_records.end(), [id](const kvp& v) { return v.second.entity->id == id; });
-    if (it != m_records.end()) {
-        it->second.waitTask();
-        m_records.erase(it);
-        m_deleted.push_back({ std::string(), id });
-        return true;
-    }
-    return false;
+    m_tasks.wait();
+    return eraseByID(id, Identifier(std::string(), id));
 }
 
 bool EntityManager::erase(const Identifier& identifier)
 {
-    auto it = m_records.find(identifier.name);
-    if (it == m_records.end() && identifier.id != InvalidID) {
-        int id = identifier.id;
-        it = std::find_if(m_records.begin(), m_records.end(), [id](const kvp& v) { return v.second.entity->id == id; });
-    }
-    if (it != m_records.end()) {
-        it->second.waitTask();
-        m_records.erase(it);
-        m_deleted.push_back(identifier);
-        return true;
+    // erased records must not be referenced by checksum tasks
+    m_tasks.wait();
+
+    uint64_t hash = PathHash(identifier.name);
+    auto& shard = getShard(hash);
+    {
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        if (auto *index = shard.indices.find(identifier.name, hash))
+            return eraseRecord(shard, *index, identifier);
     }
+    if (identifier.id != InvalidID)
+        return eraseByID(identifier.id, identifier);
     return false;
 }
 
@@ -86,10 +95,37 @@ bool EntityManager::erase(TransformPtr v)
 
 bool EntityManager::eraseThreadSafe(TransformPtr v)
 {
-    std::unique_lock<std::mutex> lock(m_mutex);
+    // erase() locks shards by itself
     return erase(v);
 }
 
+bool EntityManager::eraseRecord(Shard& shard, int index, const Identifier& identifier)
+{
+    auto& rec = shard.records[index];
+    if (!rec.entity)
+        return false;
+
+    shard.indices.erase(rec.entity->path);
+    rec = Record();
+    shard.vacant.push_back(index);
+    addDeleted(identifier);
+    return true;
+}
+
+bool EntityManager::eraseByID(int id, const Identifier& identifier)
+{
+    for (auto& shard : m_shards) {
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        int n = (int)shard.records.size();
+        for (int i = 0; i < n; ++i) {
+            auto& rec = shard.records[i];
+            if (rec.entity && rec.entity->id == id)
+                return eraseRecord(shard, i, identifier);
+        }
+    }
+    return false;
+}
+
 inline void EntityManager::addTransform(TransformPtr obj)
 {
     auto& rec = lockAndGet(obj->path);
@@ -121,14 +157,18 @@ inline void EntityManager::addGeometry(TransformPtr obj)
 {
     auto& rec = lockAndGet(obj->path);
     rec.updated = true;
-    rec.waitTask();
+    if (rec.task_generation == m_task_generation) {
+        // added twice before tasks are waited. the previous task must be done first.
+        m_tasks.wait();
+    }
+    rec.task_generation = m_task_generation;
 
     if (!rec.entity) {
         rec.entity = obj;
         rec.order = ++m_order;
         rec.dirty_geom = true;
 
-        rec.task = std::async(std::launch::async, [this, obj, &rec]() {
+        m_tasks.run([this, obj, &rec]() {
             rec.checksum_trans = obj->checksumTrans();
             rec.checksum_geom = obj->checksumGeom();
         });
@@ -136,7 +176,7 @@ inline void EntityManager::addGeometry(TransformPtr obj)
     else {
         rec.entity = obj;
 
-        rec.task = std::async(std::launch::async, [this, obj, &rec]() {
+        m_tasks.run([this, obj, &rec]() {
             auto checksum_trans = obj->checksumTrans();
             auto checksum_geom = obj->checksumGeom();
             if (rec.checksum_geom != checksum_geom) {
@@ -166,9 +206,11 @@ void EntityManager::add(TransformPtr obj)
 
 void EntityManager::touch(const std::string& path)
 {
-    auto it = m_records.find(path);
-    if (it != m_records.end())
-        it->second.updated = true;
+    uint64_t hash = PathHash(path);
+    auto& shard = getShard(hash);
+    std::unique_lock<std::mutex> lock(shard.mutex);
+    if (auto *index = shard.indices.find(path, hash))
+        shard.records[*index].updated = true;
 }
 
 std::vector<TransformPtr> EntityManager::getAllEntities()
@@ -176,8 +218,10 @@ std::vector<TransformPtr> EntityManager::getAllEntities()
     waitTasks();
 
     std::vector<TransformPtr> ret;
-    for (auto& v : m_records)
-        ret.push_back(v.second.entity);
+    eachRecord([&](Record& r) {
+        ret.push_back(r.entity);
+    });
+    SortByPath(ret);
     return ret;
 }
 
@@ -186,17 +230,17 @@ std::vector<TransformPtr> EntityManager::getDirtyTransforms()
     waitTasks();
 
     std::vector<TransformPtr> ret;
-    for (auto& p : m_records) {
-        auto& r = p.second;
-        if (r.dirty_trans) {
-            if (r.entity->isGeometry()) {
-                auto t = Transform::create();
-                *t = *r.entity;
-                ret.push_back(t);
-            }
-            else {
-                ret.push_back(r.entity);
-            }
+    eachRecord([&](Record& r) {
+        if (r.dirty_trans)
+            ret.push_back(r.entity);
+    });
+    SortByPath(ret);
+
+    for (auto& e : ret) {
+        if (e->isGeometry()) {
+            auto t = Transform::create();
+            *t = *e;
+            e = t;
         }
     }
     return ret;
@@ -207,12 +251,11 @@ std::vector<TransformPtr> EntityManager::getDirtyGeometries()
     waitTasks();
 
     std::vector<TransformPtr> ret;
-    for (auto& p : m_records) {
-        auto& r = p.second;
-        if (r.dirty_geom) {
+    eachRecord([&](Record& r) {
+        if (r.dirty_geom)
             ret.push_back(r.entity);
-        }
-    }
+    });
+    SortByPath(ret);
     return ret;
 }
 
@@ -223,22 +266,24 @@ std::vector<Identifier>& EntityManager::getDeleted()
 
 void EntityManager::makeDirtyAll()
 {
-    for (auto& p : m_records) {
-        auto& r = p.second;
-        if(r.entity->isGeometry())
+    eachRecord([&](Record& r) {
+        if (r.entity->isGeometry())
             r.dirty_geom = true;
         else
             r.dirty_trans = true;
-    }
+    });
 }
 
 void EntityManager::clearDirtyFlags()
 {
-    for (auto& p : m_records) {
-        auto& r = p.second;
+    eachRecord([&](Record& r) {
         r.updated = r.dirty_geom = r.dirty_trans = false;
-    }
+    });
+
+    std::unique_lock<std::mutex> lock(m_deleted_mutex);
     m_deleted.clear();
+    m_deleted_indices.clear();
+    m_num_deleted = 0;
 }
 
 std::vector<TransformPtr> EntityManager::getStaleEntities()
@@ -246,23 +291,24 @@ std::vector<TransformPtr> EntityManager::getStaleEntities()
     waitTasks();
 
     std::vector<TransformPtr> ret;
-    for (auto& p : m_records) {
-        auto& r = p.second;
+    eachRecord([&](Record& r) {
         if (!r.updated)
             ret.push_back(r.entity);
-    }
+    });
+    SortByPath(ret);
     return ret;
 }
 
 void EntityManager::eraseStaleEntities()
 {
-    for (auto it = m_records.begin(); it != m_records.end(); ) {
-        if (!it->second.updated) {
-            m_deleted.push_back(it->second.entity->getIdentifier());
-            m_records.erase(it++);
+    for (auto& shard : m_shards) {
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        int n = (int)shard.records.size();
+        for (int i = 0; i < n; ++i) {
+            auto& rec = shard.records[i];
+            if (rec.entity && !rec.updated)
+                eraseRecord(shard, i, rec.entity->getIdentifier());
         }
-        else
-            ++it;
     }
 }
 
@@ -273,27 +319,83 @@ void EntityManager::setAlwaysMarkDirty(bool v)
 
 void EntityManager::waitTasks()
 {
-    for (auto& p : m_records)
-        p.second.waitTask();
+    m_tasks.wait();
+    ++m_task_generation;
+}
+
+EntityManager::Shard& EntityManager::getShard(uint64_t hash)
+{
+    return m_shards[hash >> (64 - ShardBits)];
+}
+
+template<class Body>
+inline void EntityManager::eachRecord(const Body& body)
+{
+    for (auto& shard : m_shards) {
+        for (auto& rec : shard.records) {
+            if (rec.entity)
+                body(rec);
+        }
+    }
 }
 
 EntityManager::Record& EntityManager::lockAndGet(const std::string &path)
 {
-    std::unique_lock<std::mutex> lock(m_mutex);
-    if (!m_deleted.empty()) {
-        auto it = std::find_if(m_deleted.begin(), m_deleted.end(), [&path](Identifier& v) { return v.name == path; });
-        if (it != m_deleted.end())
-            m_deleted.erase(it);
+    uint64_t hash = PathHash(path);
+    if (m_num_deleted > 0)
+        removeDeleted(path, hash);
+
+    auto& shard = getShard(hash);
+    std::unique_lock<std::mutex> lock(shard.mutex);
+    if (auto *index = shard.indices.find(path, hash))
+        return shard.records[*index];
+
+    int index;
+    if (!shard.vacant.empty()) {
+        index = shard.vacant.back();
+        shard.vacant.pop_back();
+    }
+    else {
+        index = (int)shard.records.size();
+        shard.records.emplace_back();
+    }
+    shard.indices.get(path, hash) = index;
+    return shard.records[index];
+}
+
+void EntityManager::addDeleted(const Identifier& identifier)
+{
+    std::unique_lock<std::mutex> lock(m_deleted_mutex);
+    if (!identifier.name.empty()) {
+        uint64_t hash = PathHash(identifier.name);
+        if (auto *index = m_deleted_indices.find(identifier.name, hash)) {
+            m_deleted[*index] = identifier;
+            return;
+        }
+        m_deleted_indices.get(identifier.name, hash) = (int)m_deleted.size();
     }
-    return m_records[path];
+    m_deleted.push_back(identifier);
+    m_num_deleted = (int)m_deleted.size();
 }
 
-void EntityManager::Record::waitTask()
+void EntityManager::removeDeleted(const std::string& path, uint64_t hash)
 {
-    if (task.valid()) {
-        task.wait();
-        task = {};
+    std::unique_lock<std::mutex> lock(m_deleted_mutex);
+    auto *index = m_deleted_indices.find(path, hash);
+    if (!index)
+        return;
+
+    // swap with the last one and pop
+    int i = *index;
+    m_deleted_indices.erase(path, hash);
+    int last = (int)m_deleted.size() - 1;
+    if (i != last) {
+        m_deleted[i] = std::move(m_deleted[last]);
+        if (!m_deleted[i].name.empty())
+            m_deleted_indices[m_deleted[i].name] = i;
     }
+    m_deleted.pop_back();
+    m_num_deleted = (int)m_deleted.size();
 }
 
 } // namespace ms
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <deque>
 #include "../SceneGraph/msSceneGraph.h"
 
 namespace ms {
@@ -43,29 +44,52 @@ public:
 private:
     struct Record
     {
-        TransformPtr entity;
+        TransformPtr entity; // null if erased
         int order = 0;
         uint64_t checksum_trans = 0;
         uint64_t checksum_geom = 0;
         bool dirty_trans = false;
         bool dirty_geom = false;
         bool updated = false;
-        std::future<void> task;
+        int task_generation = -1; // checksum task is pending if this equals m_task_generation
+    };
 
-        void waitTask();
+    // records are split into shards by path hash to reduce lock contention on add().
+    // records are in deque to keep references valid while checksum tasks are running. erased ones are reused.
+    static const int ShardBits = 4;
+    static const int NumShards = 1 << ShardBits;
+    struct Shard
+    {
+        std::mutex mutex;
+        mu::flat_hash_map<std::string, int> indices; // path -> index in records
+        std::deque<Record> records;
+        std::vector<int> vacant;
     };
+
     void waitTasks();
     Record& lockAndGet(const std::string& path);
     void addTransform(TransformPtr v);
     void addGeometry(TransformPtr v);
+    Shard& getShard(uint64_t hash);
+    // shard must be locked
+    bool eraseRecord(Shard& shard, int index, const Identifier& identifier);
+    bool eraseByID(int id, const Identifier& identifier);
+    template<class Body> void eachRecord(const Body& body);
 
-    using kvp = std::map<std::string, Record>::value_type;
+    void addDeleted(const Identifier& identifier);
+    void removeDeleted(const std::string& path, uint64_t hash);
 
-    int m_order = 0;
+    std::atomic_int m_order{ 0 };
+    int m_task_generation = 0; // incremented when all checksum tasks are done
     bool m_always_mark_dirty = false;
-    std::map<std::string, Record> m_records;
+    Shard m_shards[NumShards];
+
+    // m_deleted_mutex guards m_deleted and m_deleted_indices. m_num_deleted allows add() to skip locking it.
+    std::mutex m_deleted_mutex;
+    std::atomic_int m_num_deleted{ 0 };
     std::vector<Identifier> m_deleted;
-    std::mutex m_mutex;
+    mu::flat_hash_map<std::string, int> m_deleted_indices; // path -> index in m_deleted
+    mu::task_group m_tasks;
 };
 
 } // namespace ms
@@ -3,6 +3,12 @@
 
 namespace ms {
 
+// records are not ordered. sort results by id to keep the order of materials.
+static void SortByID(std::vector<MaterialPtr>& v)
+{
+    std::sort(v.begin(), v.end(), [](const MaterialPtr& a, const MaterialPtr& b) { return a->id < b->id; });
+}
+
 MaterialManager::MaterialManager()
 {
 }
@@ -20,14 +26,16 @@ void MaterialManager::clear()
 {
     m_records.clear();
     m_deleted.clear();
+    m_deleted_indices.clear();
+    m_num_deleted = 0;
 }
 
 bool MaterialManager::erase(int id)
 {
-    auto it = m_records.find(id);
-    if (it != m_records.end()) {
-        m_deleted.push_back(it->second.material->getIdentifier());
-        m_records.erase(it);
+    auto *rec = m_records.find(id);
+    if (rec) {
+        addDeleted(rec->material->getIdentifier());
+        m_records.erase(id);
         return true;
     }
     return false;
@@ -35,8 +43,8 @@ bool MaterialManager::erase(int id)
 
 MaterialPtr MaterialManager::find(int id) const
 {
-    auto it = m_records.find(id);
-    return it != m_records.end() ? it->second.material : nullptr;
+    auto *rec = m_records.find(id);
+    return rec ? rec->material : nullptr;
 }
 
 int MaterialManager::add(MaterialPtr material)
@@ -44,11 +52,16 @@ int MaterialManager::add(MaterialPtr material)
     if (!material || material->id == InvalidID)
         return InvalidID;
 
-    auto& rec = lockAndGet(material->id);
+    // records may be moved by other threads' add(). calculate checksum first and update the record in the lock.
+    auto csum = material->checksum();
+    int id = material->id;
+    if (m_num_deleted > 0)
+        removeDeleted(id);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto& rec = m_records[id];
     rec.material = material;
     rec.updated = true;
-
-    auto csum = material->checksum();
     if (rec.checksum != csum) {
         rec.checksum = csum;
         rec.dirty = true;
@@ -61,17 +74,21 @@ int MaterialManager::add(MaterialPtr material)
 std::vector<MaterialPtr> MaterialManager::getAllMaterials()
 {
     std::vector<MaterialPtr> ret;
-    for (auto& v : m_records)
-        ret.push_back(v.second.material);
+    m_records.each([&](int, Record& r) {
+        ret.push_back(r.material);
+    });
+    SortByID(ret);
     return ret;
 }
 
 std::vector<MaterialPtr> MaterialManager::getDirtyMaterials()
 {
     std::vector<MaterialPtr> ret;
-    for (auto& v : m_records)
-        if (v.second.dirty)
-            ret.push_back(v.second.material);
+    m_records.each([&](int, Record& r) {
+        if (r.dirty)
+            ret.push_back(r.material);
+    });
+    SortByID(ret);
     return ret;
 }
 
@@ -82,41 +99,43 @@ std::vector<Identifier>& MaterialManager::getDeleted()
 
 void MaterialManager::makeDirtyAll()
 {
-    for (auto& p : m_records) {
-        p.second.dirty = true;
-    }
+    m_records.each([&](int, Record& r) {
+        r.dirty = true;
+    });
 }
 
 void MaterialManager::clearDirtyFlags()
 {
-    for (auto& p : m_records) {
-        auto& r = p.second;
+    m_records.each([&](int, Record& r) {
         r.updated = r.dirty = false;
-    }
+    });
     m_deleted.clear();
+    m_deleted_indices.clear();
+    m_num_deleted = 0;
 }
 
 std::vector<MaterialPtr> MaterialManager::getStaleMaterials()
 {
     std::vector<MaterialPtr> ret;
-    for (auto& p : m_records) {
-        auto& r = p.second;
+    m_records.each([&](int, Record& r) {
         if (!r.updated)
             ret.push_back(r.material);
-    }
+    });
+    SortByID(ret);
     return ret;
 }
 
 void MaterialManager::eraseStaleMaterials()
 {
-    for (auto it = m_records.begin(); it != m_records.end(); ) {
-        if (!it->second.updated) {
-            m_deleted.push_back(it->second.material->getIdentifier());
-            m_records.erase(it++);
-        }
-        else
-            ++it;
-    }
+    // erasing shifts elements. collect first.
+    std::vector<int> stale;
+    m_records.each([&](int id, Record& r) {
+        if (!r.updated)
+            stale.push_back(id);
+    });
+    std::sort(stale.begin(), stale.end());
+    for (int id : stale)
+        erase(id);
 }
 
 void MaterialManager::setAlwaysMarkDirty(bool v)
@@ -124,15 +143,35 @@ void MaterialManager::setAlwaysMarkDirty(bool v)
     m_always_mark_dirty = v;
 }
 
-MaterialManager::Record& MaterialManager::lockAndGet(int id)
+void MaterialManager::addDeleted(const Identifier& identifier)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (auto *index = m_deleted_indices.find(identifier.id)) {
+        m_deleted[*index] = identifier;
+        return;
+    }
+    m_deleted_indices[identifier.id] = (int)m_deleted.size();
+    m_deleted.push_back(identifier);
+    m_num_deleted = (int)m_deleted.size();
+}
+
+void MaterialManager::removeDeleted(int id)
 {
     std::unique_lock<std::mutex> lock(m_mutex);
-    if (!m_deleted.empty()) {
-        auto it = std::find_if(m_deleted.begin(), m_deleted.end(), [&id](Identifier& v) { return v.id == id; });
-        if (it != m_deleted.end())
-            m_deleted.erase(it);
+    auto *index = m_deleted_indices.find(id);
+    if (!index)
+        return;
+
+    // swap with the last one and pop
+    int i = *index;
+    m_deleted_indices.erase(id);
+    int last = (int)m_deleted.size() - 1;
+    if (i != last) {
+        m_deleted[i] = std::move(m_deleted[last]);
+        m_deleted_indices[m_deleted[i].id] = i;
     }
-    return m_records[id];
+    m_deleted.pop_back();
+    m_num_deleted = (int)m_deleted.size();
 }
 
 } // namespace ms
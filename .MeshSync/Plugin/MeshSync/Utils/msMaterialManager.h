@@ -42,12 +42,17 @@ private:
         bool dirty = false;
         bool updated = false;
     };
-    Record& lockAndGet(int id);
+    void addDeleted(const Identifier& identifier);
+    void removeDeleted(int id);
 
     bool m_always_mark_dirty = false;
-    std::map<int, Record> m_records;
-    std::vector<Identifier> m_deleted;
+    mu::flat_hash_map<int, Record> m_records;
+
+    // m_mutex guards m_records on add(). m_deleted_indices: id -> index in m_deleted
     std::mutex m_mutex;
+    std::atomic_int m_num_deleted{ 0 };
+    std::vector<Identifier> m_deleted;
+    mu::flat_hash_map<int, int> m_deleted_indices;
 };
 
 } // namespace ms
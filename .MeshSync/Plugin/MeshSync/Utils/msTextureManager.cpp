@@ -31,6 +31,7 @@ void TextureManager::clear()
 
 bool TextureManager::erase(const std::string& name)
 {
+    m_tasks.wait();
     return m_records.erase(name) != 0;
 }
 
@@ -49,8 +50,8 @@ int TextureManager::addImage(const std::string& name, int width, int height, con
         rec.texture->id :
         (data && size ? genID() : -1);
 
-    // not worth to make tasks
-    auto checksum = SumInt32(data, size);
+    // large images are hashed in parallel inside
+    auto checksum = Hash64(data, size);
     if (!rec.texture || rec.checksum != checksum) {
         rec.checksum = checksum;
         rec.texture = Texture::create();
@@ -75,8 +76,12 @@ int TextureManager::addFile(const std::string& path, TextureType type)
         rec.texture->id :
         (FileExists(path.c_str()) ? genID() : -1);
 
-    rec.waitTask();
-    rec.task = std::async(std::launch::async, [this, path, type, &rec, id]() {
+    if (rec.task_generation == m_task_generation) {
+        // added twice before tasks are waited. the previous task must be done first.
+        m_tasks.wait();
+    }
+    rec.task_generation = m_task_generation;
+    m_tasks.run([this, path, type, &rec, id]() {
         auto mtime = FileMTime(path.c_str());
         if (!rec.texture || rec.mtime != mtime) {
             rec.mtime = mtime;
@@ -103,7 +108,7 @@ int TextureManager::add(TexturePtr tex)
         return InvalidID;
 
     auto& rec = lockAndGet(tex->name);
-    auto checksum = SumInt32(tex->data.data(), tex->data.size());
+    auto checksum = Hash64(tex->data.data(), tex->data.size());
     if (!rec.texture || rec.checksum != checksum) {
         rec.checksum = checksum;
         rec.texture = tex;
@@ -162,8 +167,8 @@ int TextureManager::genID()
 
 void TextureManager::waitTasks()
 {
-    for (auto& p : m_records)
-        p.second.waitTask();
+    m_tasks.wait();
+    ++m_task_generation;
 }
 
 TextureManager::Record& TextureManager::lockAndGet(const std::string &path)
@@ -172,12 +177,4 @@ TextureManager::Record& TextureManager::lockAndGet(const std::string &path)
     return m_records[path];
 }
 
-void TextureManager::Record::waitTask()
-{
-    if (task.valid()) {
-        task.wait();
-        task = {};
-    }
-}
-
 } // namespace ms
@@ -35,18 +35,18 @@ private:
         uint64_t mtime = 0;
         uint64_t checksum = 0;
         bool dirty = false;
-        std::future<void> task;
-
-        void waitTask();
+        int task_generation = -1; // file task is pending if this equals m_task_generation
     };
     int genID();
     void waitTasks();
     Record& lockAndGet(const std::string& path);
 
     int m_id_seed = 0;
+    int m_task_generation = 0; // incremented when all file tasks are done
     bool m_always_mark_dirty = false;
     std::map<std::string, Record> m_records;
     std::mutex m_mutex;
+    mu::task_group m_tasks;
 };
 
 } // namespace ms
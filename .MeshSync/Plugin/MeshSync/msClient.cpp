@@ -11,6 +11,11 @@ Client::Client(const ClientSettings & settings)
 {
 }
 
+Client::~Client()
+{
+    endSession();
+}
+
 const std::string& Client::getErrorMessage() const
 {
     return m_error_message;
@@ -59,143 +64,87 @@ bool Client::isServerAvailable(int timeout_ms)
     return false;
 }
 
-ScenePtr Client::send(const GetMessage& mes)
+void Client::beginSession()
 {
-    ScenePtr ret;
-    try {
-        HTTPClientSession session{ m_settings.server, m_settings.port };
-        session.setTimeout(m_settings.timeout_ms * 1000);
-
-        {
-            HTTPRequest request{ HTTPRequest::HTTP_POST, "get" };
-            request.setContentType("application/octet-stream");
-            request.setExpectContinue(true);
-            request.setContentLength(ssize(mes));
-            auto& os = session.sendRequest(request);
-            mes.serialize(os);
-            os.flush();
-        }
-
-        {
-            HTTPResponse response;
-            auto& is = session.receiveResponse(response);
-            try {
-                ret.reset(new Scene());
-                ret->deserialize(is);
-            }
-            catch (const std::exception&) {
-                ret.reset();
-            }
-        }
-    }
-    catch (...) {
-    }
-    return ret;
+    if (m_session)
+        return;
+    m_session.reset(new HTTPClientSession{ m_settings.server, m_settings.port });
+    m_session->setKeepAlive(true);
 }
 
-bool Client::send(const SetMessage& mes)
+void Client::endSession()
 {
+    if (!m_session)
+        return;
     try {
-        HTTPClientSession session{ m_settings.server, m_settings.port };
-        session.setTimeout(m_settings.timeout_ms * 1000);
-
-        HTTPRequest request{ HTTPRequest::HTTP_POST, "set" };
-        request.setContentType("application/octet-stream");
-        request.setExpectContinue(true);
-        request.setContentLength(ssize(mes));
-        auto& os = session.sendRequest(request);
-        mes.serialize(os);
-        os.flush();
-
-        HTTPResponse response;
-        auto& rs = session.receiveResponse(response);
-        std::ostringstream ostr;
-        StreamCopier::copyStream(rs, ostr);
-        return response.getStatus() == HTTPResponse::HTTP_OK;
+        m_session->reset();
     }
     catch (...) {
-        return false;
     }
+    m_session.reset();
 }
 
-bool Client::send(const DeleteMessage& mes)
+bool Client::isInSession() const
 {
-    try {
-        HTTPClientSession session{ m_settings.server, m_settings.port };
-        session.setTimeout(m_settings.timeout_ms * 1000);
-
-        HTTPRequest request{ HTTPRequest::HTTP_POST, "delete" };
-        request.setContentType("application/octet-stream");
-        request.setExpectContinue(true);
-        request.setContentLength(ssize(mes));
-        auto& os = session.sendRequest(request);
-        mes.serialize(os);
-        os.flush();
-
-        HTTPResponse response;
-        auto& rs = session.receiveResponse(response);
-        std::ostringstream ostr;
-        StreamCopier::copyStream(rs, ostr);
-        return response.getStatus() == HTTPResponse::HTTP_OK;
-    }
-    catch (...) {
-        return false;
-    }
+    return m_session != nullptr;
 }
 
-bool Client::send(const FenceMessage& mes)
+bool Client::post(const char *uri, const Message& mes, int timeout_ms, const ResponseHandler& on_response)
 {
-    try {
-        HTTPClientSession session{ m_settings.server, m_settings.port };
-        session.setTimeout(m_settings.timeout_ms * 1000);
-
-        HTTPRequest request{ HTTPRequest::HTTP_POST, "fence" };
-        request.setContentType("application/octet-stream");
-        request.setExpectContinue(true);
-        request.setContentLength(ssize(mes));
-        auto& os = session.sendRequest(request);
-        mes.serialize(os);
-        os.flush();
-
-        HTTPResponse response;
-        auto& rs = session.receiveResponse(response);
-        std::ostringstream ostr;
-        StreamCopier::copyStream(rs, ostr);
-        return response.getStatus() == HTTPResponse::HTTP_OK;
-    }
-    catch (...) {
-        return false;
+    // use the persistent session if in session mode. otherwise connect for this request only.
+    std::unique_ptr<HTTPClientSession> tmp_session;
+    HTTPClientSession *session = m_session.get();
+    if (!session) {
+        tmp_session.reset(new HTTPClientSession{ m_settings.server, m_settings.port });
+        session = tmp_session.get();
     }
-}
 
-ResponseMessagePtr Client::send(const QueryMessage& mes, int timeout_ms)
-{
-    ResponseMessagePtr ret;
     try {
-        HTTPClientSession session{ m_settings.server, m_settings.port };
-        session.setTimeout(timeout_ms * 1000);
+        session->setTimeout(timeout_ms * 1000);
 
         {
-            HTTPRequest request{ HTTPRequest::HTTP_POST, "query" };
+            HTTPRequest request{ HTTPRequest::HTTP_POST, uri, HTTPMessage::HTTP_1_1 };
             request.setContentType("application/octet-stream");
-            request.setExpectContinue(true);
-            request.setContentLength(ssize(mes));
-            auto& os = session.sendRequest(request);
-            mes.serialize(os);
+            if (m_session) {
+                // no 100-continue handshake on a connection that is already established.
+                // requests are sent back-to-back and the response is drained right after.
+                request.setKeepAlive(true);
+            }
+            else {
+                request.setKeepAlive(false);
+                request.setExpectContinue(true);
+            }
+
+            // serialize once into a reusable buffer. the size is known after that and the buffer is sent as is.
+            // (ssize() + serialize() would walk and copy the whole message twice)
+            m_send_buffer.reset();
+            mes.serialize(m_send_buffer);
+            m_send_buffer.flush();
+            auto& data = m_send_buffer.getBuffer();
+            request.setContentLength(data.size());
+
+            auto& os = session->sendRequest(request);
+            os.write(data.data(), data.size());
             os.flush();
         }
 
         {
             HTTPResponse response;
-            auto& is = session.receiveResponse(response);
-            if (response.getStatus() == HTTPResponse::HTTP_OK) {
-                ret.reset(new ResponseMessage());
-                ret->deserialize(is);
-            }
-            else {
+            auto& is = session->receiveResponse(response);
+            bool ok = response.getStatus() == HTTPResponse::HTTP_OK;
+            if (ok && on_response)
+                on_response(is);
+
+            // response body must be fully consumed to reuse the connection
+            std::ostringstream ostr;
+            StreamCopier::copyStream(is, ostr);
+            if (!ok) {
                 m_error_message = "Server is stopped.";
+                return false;
             }
         }
+        m_error_message.clear();
+        return true;
     }
     catch (const Poco::TimeoutException& /*e*/) {
         // in this case e.what() is empty.
@@ -204,6 +153,81 @@ ResponseMessagePtr Client::send(const QueryMessage& mes, int timeout_ms)
     catch (const Poco::Exception& e) {
         m_error_message = e.what();
     }
+    catch (const std::exception& e) {
+        m_error_message = e.what();
+    }
+
+    // connection state is unknown. drop it and reconnect on next request.
+    if (m_session) {
+        try {
+            m_session->reset();
+        }
+        catch (...) {
+        }
+    }
+    return false;
+}
+
+ScenePtr Client::send(const GetMessage& mes)
+{
+    ScenePtr ret;
+    bool ok = post("get", mes, m_settings.timeout_ms, [&ret](std::istream& is) {
+        try {
+            ret.reset(new Scene());
+            ret->deserialize(is);
+        }
+        catch (const std::exception&) {
+            ret.reset();
+        }
+    });
+    if (!ok)
+        ret.reset();
+    return ret;
+}
+
+bool Client::send(const SetMessage& mes)
+{
+    return post("set", mes, m_settings.timeout_ms);
+}
+
+bool Client::send(const SetMessage& mes, std::vector<std::string>& retained)
+{
+    retained.clear();
+    return post("set", mes, m_settings.timeout_ms, [&retained](std::istream& is) {
+        // "ok" and paths of retained meshes, one per line
+        std::string line;
+        std::getline(is, line);
+        while (std::getline(is, line)) {
+            if (!line.empty())
+                retained.push_back(line);
+        }
+    });
+}
+
+bool Client::send(const DeleteMessage& mes)
+{
+    return post("delete", mes, m_settings.timeout_ms);
+}
+
+bool Client::send(const FenceMessage& mes)
+{
+    return post("fence", mes, m_settings.timeout_ms);
+}
+
+bool Client::send(const DeltaMessage& mes)
+{
+    return post("delta", mes, m_settings.timeout_ms);
+}
+
+ResponseMessagePtr Client::send(const QueryMessage& mes, int timeout_ms)
+{
+    ResponseMessagePtr ret;
+    bool ok = post("query", mes, timeout_ms, [&ret](std::istream& is) {
+        ret.reset(new ResponseMessage());
+        ret->deserialize(is);
+    });
+    if (!ok)
+        ret.reset();
     return ret;
 }
 
@@ -2,6 +2,12 @@
 
 #include "msProtocol.h"
 
+namespace Poco {
+    namespace Net {
+        class HTTPClientSession;
+    }
+}
+
 namespace ms {
 
 struct ClientSettings
@@ -15,6 +21,7 @@ class Client
 {
 public:
     Client(const ClientSettings& settings);
+    ~Client();
 
     const std::string& getErrorMessage() const;
 
@@ -22,16 +29,31 @@ public:
     // (could not reach server, protocol version doesn't match, etc)
     bool isServerAvailable(int timeout_ms = 100);
 
+    // keep one connection alive and reuse it for all send() until endSession().
+    // intended to wrap a fence-delimited scene (SceneBegin ... SceneEnd).
+    void beginSession();
+    void endSession();
+    bool isInSession() const;
+
     ScenePtr send(const GetMessage& mes);
     bool send(const SetMessage& mes);
+    // retained: paths of meshes the server keeps as bases of deltas (see SetMessage::use_delta)
+    bool send(const SetMessage& mes, std::vector<std::string>& retained);
     bool send(const DeleteMessage& mes);
     bool send(const FenceMessage& mes);
+    // fails if the server doesn't have the base mesh of the delta
+    bool send(const DeltaMessage& mes);
     ResponseMessagePtr send(const QueryMessage& mes);
     ResponseMessagePtr send(const QueryMessage& mes, int timeout_ms);
 
 private:
+    using ResponseHandler = std::function<void(std::istream& is)>;
+    bool post(const char *uri, const Message& mes, int timeout_ms, const ResponseHandler& on_response = {});
+
     ClientSettings m_settings;
     std::string m_error_message;
+    MemoryStream m_send_buffer;
+    std::unique_ptr<Poco::Net::HTTPClientSession> m_session;
 };
 
 } // namespace ms
@@ -3,7 +3,7 @@
 #define msPluginVersion 20190423
 #define msPluginVersionStr "20190423"
 #define msVendor "Unity Technologies"
-#define msProtocolVersion 114
+#define msProtocolVersion 120
 //#define msEnableProfiling
 
 namespace mu {}
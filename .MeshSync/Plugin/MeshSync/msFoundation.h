@@ -272,26 +272,27 @@ struct vhash_impl<RawVector<T>>
     }
 };
 
+// checksums are 64 bit hashes of the contents (mu::Hash64()). unlike sums, they change when data are reordered.
 template<class T, bool is_enum = std::is_enum<T>::value> struct csum_impl2;
-template<class T> struct csum_impl2<T, true> { uint64_t operator()(T v) { return static_cast<uint64_t>(v); } };
+template<class T> struct csum_impl2<T, true> { uint64_t operator()(T v) { return mu::Hash64(&v, sizeof(T)); } };
 
 template<class T> struct csum_impl { uint64_t operator()(const T& v) { return csum_impl2<T>()(v); } };
-template<> struct csum_impl<bool> { uint64_t operator()(bool v) { return (uint32_t)v; } };
-template<> struct csum_impl<int> { uint64_t operator()(int v) { return (uint32_t&)v; } };
-template<> struct csum_impl<uint32_t> { uint64_t operator()(uint32_t v) { return (uint32_t&)v; } };
-template<> struct csum_impl<float> { uint64_t operator()(float v) { return (uint32_t&)v; } };
-template<> struct csum_impl<float2> { uint64_t operator()(const float2& v) { return mu::SumInt32(&v, 8); } };
-template<> struct csum_impl<float3> { uint64_t operator()(const float3& v) { return mu::SumInt32(&v, 12); } };
-template<> struct csum_impl<float4> { uint64_t operator()(const float4& v) { return mu::SumInt32(&v, 16); } };
-template<> struct csum_impl<quatf> { uint64_t operator()(const quatf& v) { return mu::SumInt32(&v, 16); } };
-template<> struct csum_impl<float4x4> { uint64_t operator()(const float4x4& v) { return mu::SumInt32(&v, 64); } };
+template<> struct csum_impl<bool> { uint64_t operator()(bool v) { return mu::Hash64(&v, sizeof(v)); } };
+template<> struct csum_impl<int> { uint64_t operator()(int v) { return mu::Hash64(&v, 4); } };
+template<> struct csum_impl<uint32_t> { uint64_t operator()(uint32_t v) { return mu::Hash64(&v, 4); } };
+template<> struct csum_impl<float> { uint64_t operator()(float v) { return mu::Hash64(&v, 4); } };
+template<> struct csum_impl<float2> { uint64_t operator()(const float2& v) { return mu::Hash64(&v, 8); } };
+template<> struct csum_impl<float3> { uint64_t operator()(const float3& v) { return mu::Hash64(&v, 12); } };
+template<> struct csum_impl<float4> { uint64_t operator()(const float4& v) { return mu::Hash64(&v, 16); } };
+template<> struct csum_impl<quatf> { uint64_t operator()(const quatf& v) { return mu::Hash64(&v, 16); } };
+template<> struct csum_impl<float4x4> { uint64_t operator()(const float4x4& v) { return mu::Hash64(&v, 64); } };
 
 template<>
 struct csum_impl<std::string>
 {
     uint64_t operator()(const std::string& v)
     {
-        return mu::SumInt32(v.c_str(), v.size());
+        return mu::Hash64(v.c_str(), v.size());
     }
 };
 template<class T>
@@ -301,7 +302,7 @@ struct csum_impl<std::vector<T>>
     {
         uint64_t ret = 0;
         for (auto& e : v)
-            ret += e.checksum();
+            ret = mu::HashCombine(ret, e.checksum());
         return ret;
     }
 };
@@ -310,7 +311,7 @@ struct csum_impl<RawVector<T>>
 {
     uint64_t operator()(const RawVector<T>& v)
     {
-        return mu::SumInt32(v.data(), sizeof(T) * v.size());
+        return mu::Hash64(v.data(), sizeof(T) * v.size());
     }
 };
 
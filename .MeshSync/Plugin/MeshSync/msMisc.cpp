@@ -1,5 +1,11 @@
 #include "pch.h"
 #include "msMisc.h"
+#ifndef _WIN32
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
 
 namespace ms {
 
@@ -71,4 +77,91 @@ uint64_t FileMTime(const char *path)
     }
 }
 
+
+MappedFile::MappedFile()
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const char *path)
+{
+    close();
+    if (!path)
+        return false;
+
+#ifdef _WIN32
+    // path is utf-8
+    int wlen = ::MultiByteToWideChar(CP_UTF8, 0, path, -1, nullptr, 0);
+    std::wstring wpath(wlen, L'\0');
+    ::MultiByteToWideChar(CP_UTF8, 0, path, -1, &wpath[0], wlen);
+
+    HANDLE file = ::CreateFileW(wpath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    m_file = file;
+
+    LARGE_INTEGER size;
+    if (!::GetFileSizeEx(m_file, &size) || size.QuadPart == 0 || (uint64_t)size.QuadPart > (uint64_t)SIZE_MAX) {
+        close();
+        return false;
+    }
+    m_mapping = ::CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!m_mapping) {
+        close();
+        return false;
+    }
+    m_data = (const char*)::MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!m_data) {
+        close();
+        return false;
+    }
+    m_size = (size_t)size.QuadPart;
+#else
+    int fd = ::open(path, O_RDONLY);
+    if (fd == -1)
+        return false;
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size == 0 || (uint64_t)st.st_size > (uint64_t)SIZE_MAX) {
+        ::close(fd);
+        return false;
+    }
+    void *data = ::mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping stays valid after closing fd
+    ::close(fd);
+    if (data == MAP_FAILED)
+        return false;
+    m_data = (const char*)data;
+    m_size = (size_t)st.st_size;
+#endif
+    return true;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+    if (m_data)
+        ::UnmapViewOfFile(m_data);
+    if (m_mapping)
+        ::CloseHandle(m_mapping);
+    if (m_file)
+        ::CloseHandle(m_file);
+    m_mapping = nullptr;
+    m_file = nullptr;
+#else
+    if (m_data)
+        ::munmap((void*)m_data, m_size);
+#endif
+    m_data = nullptr;
+    m_size = 0;
+}
+
+bool MappedFile::valid() const { return m_data != nullptr; }
+const char* MappedFile::data() const { return m_data; }
+size_t MappedFile::size() const { return m_size; }
+
 } // namespace ms
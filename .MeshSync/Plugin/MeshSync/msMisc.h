@@ -10,4 +10,28 @@ bool ByteArrayToFile(const char *path, const char *data, size_t size);
 bool FileExists(const char *path);
 uint64_t FileMTime(const char *path);
 
+// read-only memory mapped file
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const char *path);
+    void close();
+    bool valid() const;
+    const char* data() const;
+    size_t size() const;
+
+private:
+    const char *m_data = nullptr;
+    size_t m_size = 0;
+#ifdef _WIN32
+    void *m_file = nullptr; // HANDLE
+    void *m_mapping = nullptr; // HANDLE
+#endif
+};
+
 } // namespace ms
@@ -4,6 +4,33 @@
 
 namespace ms {
 
+void ReadyFlag::set()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_ready = true;
+    }
+    m_cond.notify_all();
+}
+
+bool ReadyFlag::wait(int timeout_ms)
+{
+    if (m_ready)
+        return true;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return m_cond.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this]() { return m_ready.load(); });
+}
+
+ReadyFlag::operator bool() const
+{
+    return m_ready;
+}
+
+
+Message::Message(Type type)
+    : m_type(type)
+{
+}
 Message::~Message()
 {
 }
@@ -42,6 +69,7 @@ void GetFlags::setAllGetFlags()
 }
 
 GetMessage::GetMessage()
+    : super(Type::Get)
 {
     flags.setAllGetFlags();
 }
@@ -62,21 +90,31 @@ void GetMessage::deserialize(std::istream& is)
 
 
 SetMessage::SetMessage()
+    : super(Type::Set)
 {
 }
 void SetMessage::serialize(std::ostream& os) const
 {
     super::serialize(os);
+    write(os, use_delta);
     scene.serialize(os);
 }
 void SetMessage::deserialize(std::istream& is)
 {
     super::deserialize(is);
+    read(is, use_delta);
     scene.deserialize(is);
 }
+void SetMessage::deserialize(std::istream& is, const std::function<void(TransformPtr&)>& on_entity)
+{
+    super::deserialize(is);
+    read(is, use_delta);
+    scene.deserialize(is, on_entity);
+}
 
 
 DeleteMessage::DeleteMessage()
+    : super(Type::Delete)
 {
 }
 void DeleteMessage::serialize(std::ostream& os) const
@@ -93,6 +131,7 @@ void DeleteMessage::deserialize(std::istream& is)
 }
 
 
+FenceMessage::FenceMessage() : super(Type::Fence) {}
 FenceMessage::~FenceMessage() {}
 void FenceMessage::serialize(std::ostream& os) const
 {
@@ -105,6 +144,7 @@ void FenceMessage::deserialize(std::istream& is)
     read(is, type);
 }
 
+TextMessage::TextMessage() : super(Message::Type::Text) {}
 TextMessage::~TextMessage() {}
 void TextMessage::serialize(std::ostream& os) const
 {
@@ -120,12 +160,13 @@ void TextMessage::deserialize(std::istream& is)
 }
 
 
-ScreenshotMessage::ScreenshotMessage() {}
+ScreenshotMessage::ScreenshotMessage() : super(Type::Screenshot) {}
 void ScreenshotMessage::serialize(std::ostream& os) const { super::serialize(os); }
 void ScreenshotMessage::deserialize(std::istream& is) { super::deserialize(is); }
 
 
 ResponseMessage::ResponseMessage()
+    : super(Type::Response)
 {
 }
 
@@ -143,6 +184,7 @@ void ResponseMessage::deserialize(std::istream & is)
 
 
 QueryMessage::QueryMessage()
+    : super(Type::Query)
 {
 }
 
@@ -160,6 +202,7 @@ void QueryMessage::deserialize(std::istream & is)
 
 
 PollMessage::PollMessage()
+    : super(Type::Poll)
 {}
 
 void PollMessage::serialize(std::ostream& os) const
@@ -175,4 +218,23 @@ void PollMessage::deserialize(std::istream& is)
 }
 
 
+DeltaMessage::DeltaMessage()
+    : super(Type::Delta)
+{}
+
+void DeltaMessage::serialize(std::ostream& os) const
+{
+    super::serialize(os);
+    write(os, scene_settings);
+    write(os, delta);
+}
+
+void DeltaMessage::deserialize(std::istream& is)
+{
+    super::deserialize(is);
+    read(is, scene_settings);
+    read(is, delta);
+}
+
+
 } // namespace ms
@@ -1,10 +1,27 @@
 #pragma once
 
 #include <atomic>
+#include <mutex>
+#include <condition_variable>
 #include "SceneGraph/msSceneGraph.h"
 
 namespace ms {
 
+// one-shot completion flag of a request.
+// set() is called by the thread that fulfills the request and wakes up threads blocked in wait().
+class ReadyFlag
+{
+public:
+    void set();
+    bool wait(int timeout_ms); // return true if set before timeout
+    operator bool() const;
+
+private:
+    std::atomic_bool m_ready{ false };
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+};
+
 class Message
 {
 public:
@@ -19,6 +36,8 @@ public:
         Screenshot,
         Query,
         Response,
+        Poll,
+        Delta,
     };
     int protocol_version = msProtocolVersion;
     int session_id = InvalidID;
@@ -28,9 +47,16 @@ public:
     // non-serializable fields
     nanosec timestamp_recv = 0;
 
+    Message(Type type = Type::Unknown);
     virtual ~Message();
     virtual void serialize(std::ostream& os) const;
     virtual void deserialize(std::istream& is); // throw
+
+    // stored at construction. allows dispatch without RTTI.
+    Type getType() const { return m_type; }
+
+protected:
+    Type m_type;
 };
 msSerializable(Message);
 msDeclPtr(Message);
@@ -63,7 +89,7 @@ public:
     MeshRefineSettings refine_settings;
 
     // non-serializable fields
-    std::atomic_bool ready{ false };
+    ReadyFlag ready;
 
 public:
     GetMessage();
@@ -79,11 +105,15 @@ class SetMessage : public Message
 using super = Message;
 public:
     Scene scene;
+    // the sender may send DeltaMessage of meshes in this message later. the server keeps them as the base only if set.
+    bool use_delta = false;
 
 public:
     SetMessage();
     void serialize(std::ostream& os) const override;
     void deserialize(std::istream& is) override;
+    // see Scene::deserialize()
+    void deserialize(std::istream& is, const std::function<void(TransformPtr&)>& on_entity);
 };
 msSerializable(SetMessage);
 msDeclPtr(SetMessage);
@@ -117,6 +147,7 @@ public:
 
     FenceType type = FenceType::Unknown;
 
+    FenceMessage();
     ~FenceMessage() override;
     void serialize(std::ostream& os) const override;
     void deserialize(std::istream& is) override;
@@ -136,6 +167,7 @@ public:
         Error,
     };
 
+    TextMessage();
     ~TextMessage() override;
     void serialize(std::ostream& os) const override;
     void deserialize(std::istream& is) override;
@@ -154,7 +186,7 @@ using super = Message;
 public:
 
     // non-serializable fields
-    std::atomic_bool ready{ false };
+    ReadyFlag ready;
 
 public:
     ScreenshotMessage();
@@ -197,7 +229,7 @@ public:
     QueryType query_type = QueryType::Unknown;
 
     // non-serializable fields
-    std::atomic_bool ready{ false };
+    ReadyFlag ready;
     ResponseMessagePtr response;
 
     QueryMessage();
@@ -220,7 +252,7 @@ public:
     PollType poll_type = PollType::Unknown;
 
     // non-serializable fields
-    std::atomic_bool ready{ false };
+    ReadyFlag ready;
 
     PollMessage();
     void serialize(std::ostream& os) const override;
@@ -229,4 +261,21 @@ public:
 msSerializable(PollMessage);
 msDeclPtr(PollMessage);
 
+
+// changed vertices of a mesh the server already has. the server patches its retained copy and handles it as SetMessage.
+// fails if the server's copy doesn't match delta.base_checksum. the sender should send the whole mesh in that case.
+class DeltaMessage : public Message
+{
+using super = Message;
+public:
+    SceneSettings scene_settings;
+    MeshDelta delta;
+
+    DeltaMessage();
+    void serialize(std::ostream& os) const override;
+    void deserialize(std::istream& is) override;
+};
+msSerializable(DeltaMessage);
+msDeclPtr(DeltaMessage);
+
 } // namespace ms
@@ -49,6 +49,9 @@ void RequestHandler::handleRequest(HTTPServerRequest& request, HTTPServerRespons
     else if (uri == "delete") {
         m_server->recvDelete(request, response);
     }
+    else if (uri == "delta") {
+        m_server->recvDelta(request, response);
+    }
     else if (uri == "fence") {
         m_server->recvFence(request, response);
     }
@@ -103,17 +106,28 @@ Server::Server(const ServerSettings& settings)
 Server::~Server()
 {
     stop();
+    m_tasks.reset();
+    m_scheduler.reset();
     clear();
 }
 
 bool Server::start()
 {
+    if (!m_tasks) {
+        // conversion is limited to max_threads threads. it doesn't occupy all cores the host application also uses.
+        m_scheduler.reset(new mu::task_scheduler(m_settings.max_threads));
+        // recvSet() blocks when max_queue tasks are pending. this throttles clients that flood us with messages.
+        m_tasks.reset(new mu::task_group(m_settings.max_queue, *m_scheduler));
+    }
+
     if (!m_server) {
         auto* params = new HTTPServerParams;
         if (m_settings.max_queue > 0)
             params->setMaxQueued(m_settings.max_queue);
         if (m_settings.max_threads > 0)
             params->setMaxThreads(m_settings.max_threads);
+        // clients keep one connection alive during a scene transfer
+        params->setKeepAlive(true);
 
         try {
             ServerSocket svs(m_settings.port);
@@ -136,8 +150,15 @@ void Server::stop()
 
 void Server::clear()
 {
-    lock_t lock(m_message_mutex);
     m_received_messages.clear();
+    {
+        lock_t lock(m_retained_mutex);
+        m_retained_meshes.clear();
+        m_retained_lru.clear();
+    }
+
+    m_serving_scene.reset();
+    lock_t lock(m_host_scene_mutex);
     m_host_scene.reset();
 }
 
@@ -151,12 +172,31 @@ int Server::getNumMessages() const
     return (int)m_received_messages.size();
 }
 
+void Server::setMessageHandler(Message::Type type, const MessageHandler& handler)
+{
+    auto i = (size_t)type;
+    if (i >= m_message_handlers.size())
+        m_message_handlers.resize(i + 1);
+    m_message_handlers[i] = handler;
+}
+
+void Server::dispatch(const MessageHandler& handler, Message& mes)
+{
+    auto type = mes.getType();
+    auto i = (size_t)type;
+    if (i < m_message_handlers.size() && m_message_handlers[i])
+        m_message_handlers[i](type, mes);
+    else if (handler)
+        handler(type, mes);
+}
+
 int Server::processMessages(const MessageHandler& handler)
 {
     {
-        lock_t lm(m_message_mutex);
-        // just move messages to processing list to minimize contention
-        m_processing_messages.splice(m_processing_messages.end(), m_received_messages);
+        // received messages are pushed by server threads without lock. just move them to processing list.
+        MessageHolder tmp;
+        while (m_received_messages.pop(tmp))
+            m_processing_messages.push_back(std::move(tmp));
     }
 
     int ret = 0;
@@ -169,60 +209,74 @@ int Server::processMessages(const MessageHandler& handler)
             holder.task.wait();
 
         bool skip = false;
-        auto& mes = holder.message;
-        if (!mes)
+        if (!holder.message)
             goto next;
 
-        if (auto get = std::dynamic_pointer_cast<GetMessage>(mes)) {
-            m_current_get_request = get;
-            handler(Message::Type::Get, *mes);
-            m_current_get_request = nullptr;
-        }
-        else if (auto set = std::dynamic_pointer_cast<SetMessage>(mes)) {
-            if (mes->session_id == m_current_scene_session)
-            {
-                handler(Message::Type::Set, *mes);
-                m_scene_cache.push_back(set);
-            }
-            else
-                skip = true;
-        }
-        else if (auto del = std::dynamic_pointer_cast<DeleteMessage>(mes)) {
-            if (mes->session_id == m_current_scene_session)
-                handler(Message::Type::Delete, *mes);
-            else
-                skip = true;
-        }
-        else if (auto fence = std::dynamic_pointer_cast<FenceMessage>(mes)) {
-            if (fence->type == FenceMessage::FenceType::SceneBegin) {
-                if (m_current_scene_session == InvalidID)
-                    m_current_scene_session = fence->session_id;
+        {
+            auto& mes = *holder.message;
+            switch (mes.getType()) {
+            case Message::Type::Get:
+                m_current_get_request = static_cast<GetMessage*>(&mes);
+                dispatch(handler, mes);
+                m_current_get_request = nullptr;
+                break;
+
+            case Message::Type::Set:
+                if (mes.session_id == m_current_scene_session) {
+                    dispatch(handler, mes);
+                    // keep alive until SceneEnd. the holder is erased below, so just take over its reference.
+                    m_scene_cache.push_back(std::move(holder.message));
+                }
                 else
                     skip = true;
-            }
-            else if (fence->type == FenceMessage::FenceType::SceneEnd) {
-                if (m_current_scene_session == fence->session_id)
-                    m_current_scene_session = InvalidID;
+                break;
+
+            case Message::Type::Delete:
+                if (mes.session_id == m_current_scene_session)
+                    dispatch(handler, mes);
                 else
                     skip = true;
+                break;
+
+            case Message::Type::Fence:
+            {
+                auto& fence = static_cast<FenceMessage&>(mes);
+                if (fence.type == FenceMessage::FenceType::SceneBegin) {
+                    if (m_current_scene_session == InvalidID)
+                        m_current_scene_session = fence.session_id;
+                    else
+                        skip = true;
+                }
+                else if (fence.type == FenceMessage::FenceType::SceneEnd) {
+                    if (m_current_scene_session == fence.session_id)
+                        m_current_scene_session = InvalidID;
+                    else
+                        skip = true;
+                }
+
+                if (!skip) {
+                    dispatch(handler, mes);
+                    if (fence.type == FenceMessage::FenceType::SceneEnd)
+                        m_scene_cache.clear();
+                }
+                break;
             }
 
-            if (!skip) {
-                handler(Message::Type::Fence, *mes);
-                if (fence->type == FenceMessage::FenceType::SceneEnd)
-                    m_scene_cache.clear();
+            case Message::Type::Text:
+            case Message::Type::Query:
+                dispatch(handler, mes);
+                break;
+
+            case Message::Type::Screenshot:
+                // setScrrenshotFilePath() may be called after the handler returns. keep a reference.
+                m_current_screenshot_request = std::static_pointer_cast<ScreenshotMessage>(holder.message);
+                dispatch(handler, mes);
+                break;
+
+            default:
+                break;
             }
         }
-        else if (std::dynamic_pointer_cast<TextMessage>(mes)) {
-            handler(Message::Type::Text, *mes);
-        }
-        else if (auto shot = std::dynamic_pointer_cast<ScreenshotMessage>(mes)) {
-            m_current_screenshot_request = shot;
-            handler(Message::Type::Screenshot, *mes);
-        }
-        else if (auto q = std::dynamic_pointer_cast<QueryMessage>(mes)) {
-            handler(Message::Type::Query, *mes);
-        }
 
     next:
         if (skip) {
@@ -253,11 +307,8 @@ void Server::serveBinary(Poco::Net::HTTPServerResponse & response, const void *d
 {
     response.setStatus((HTTPResponse::HTTPStatus)stat);
     response.setContentType("application/octet-stream");
-    response.setContentLength(size);
-
-    auto& os = response.send();
-    os.write((const char*)data, size);
-    os.flush();
+    // sendBuffer() sets Content-Length and writes header and body directly to the socket
+    response.sendBuffer(data, size);
 }
 
 void Server::serveFiles(Poco::Net::HTTPServerResponse& response, const std::string& uri)
@@ -300,7 +351,8 @@ void Server::beginServeScene()
         msLogError("m_current_get_request is null\n");
         return;
     }
-    m_host_scene.reset(new Scene());
+    // built privately and published by endServeScene(). recvGet() never sees a scene being built.
+    m_serving_scene.reset(new Scene());
 
     auto& request = *m_current_get_request;
     request.refine_settings.scale_factor = request.scene_settings.scale_factor;
@@ -308,7 +360,7 @@ void Server::beginServeScene()
         request.scene_settings.handedness == Handedness::Right || request.scene_settings.handedness == Handedness::RightZUp;
     request.refine_settings.flags.flip_yz =
         request.scene_settings.handedness == Handedness::LeftZUp || request.scene_settings.handedness == Handedness::RightZUp;
-    m_host_scene->settings = request.scene_settings;
+    m_serving_scene->settings = request.scene_settings;
 }
 
 void Server::endServeScene()
@@ -317,13 +369,13 @@ void Server::endServeScene()
         msLogError("m_current_get_request is null\n");
         return;
     }
-    if (!m_host_scene) {
-        msLogError("m_host_scene is null\n");
+    if (!m_serving_scene) {
+        msLogError("m_serving_scene is null\n");
         return;
     }
 
     auto& request = *m_current_get_request;
-    parallel_for_each(m_host_scene->entities.begin(), m_host_scene->entities.end(), [&request, this](TransformPtr& p) {
+    parallel_for_each(m_serving_scene->entities.begin(), m_serving_scene->entities.end(), [&request, this](TransformPtr& p) {
         auto pmesh = dynamic_cast<Mesh*>(p.get());
         if (!pmesh)
             return;
@@ -336,14 +388,19 @@ void Server::endServeScene()
         mesh.refine_settings.max_bone_influence = 0;
         mesh.refine(mesh.refine_settings);
     });
-    request.ready = true;
+    {
+        // recvGet() may still be serializing the previous one. it holds its own reference.
+        lock_t lock(m_host_scene_mutex);
+        m_host_scene = std::move(m_serving_scene);
+    }
+    request.ready.set();
 }
 
 void Server::setScrrenshotFilePath(const std::string& path)
 {
     if (m_current_screenshot_request) {
         m_screenshot_file_path = path;
-        m_current_screenshot_request->ready = true;
+        m_current_screenshot_request->ready.set();
     }
 }
 
@@ -403,36 +460,30 @@ const std::string& Server::getFileRootPath() const
 
 Scene* Server::getHostScene()
 {
-    return m_host_scene.get();
+    return m_serving_scene.get();
 }
 
-Server::MessageHolder* Server::queueMessage(MessagePtr mes)
+void Server::queueMessage(MessagePtr mes)
 {
     if (!mes)
-        return nullptr;
+        return;
 
     MessageHolder t;
     t.message = mes;
     t.ready = true;
-
-    lock_t l(m_message_mutex);
-    m_received_messages.push_back(std::move(t));
-    return &m_received_messages.back();
+    m_received_messages.push(std::move(t));
 }
 
-Server::MessageHolder* Server::queueMessage(MessagePtr mes, std::future<void>&& task)
+void Server::queueMessage(MessagePtr mes, std::future<void>&& task)
 {
     if (!mes)
-        return nullptr;
+        return;
 
     MessageHolder t;
     t.message = mes;
     t.task = std::move(task);
     t.ready = true;
-
-    lock_t l(m_message_mutex);
-    m_received_messages.push_back(std::move(t));
-    return &m_received_messages.back();
+    m_received_messages.push(std::move(t));
 }
 
 void Server::queueTextMessage(const char *mes, TextMessage::Type type)
@@ -444,12 +495,9 @@ void Server::queueTextMessage(const char *mes, TextMessage::Type type)
     MessageHolder t;
     t.message.reset(txt);
     t.ready = true;
-
-    lock_t l(m_message_mutex);
-    m_received_messages.push_back(std::move(t));
+    m_received_messages.push(std::move(t));
 }
 
-
 template<class MessageT>
 std::shared_ptr<MessageT> Server::deserializeMessage(HTTPServerRequest& request, HTTPServerResponse& response)
 {
@@ -474,60 +522,157 @@ void Server::sanitizeHierarchyPath(std::string& /*path*/)
 
 void Server::recvSet(HTTPServerRequest& request, HTTPServerResponse& response)
 {
-    auto mes = deserializeMessage<SetMessage>(request, response);
-    if (!mes)
+    // convert entities on the task pool as soon as each one is received.
+    // refinement of large meshes overlaps with receiving the rest of the message.
+    // run() blocks while max_queue entities are pending. receiving waits for refinement rather than piling it up.
+    // (the number of connections is bounded by max_threads)
+    auto mes = std::make_shared<SetMessage>();
+    auto entity_tasks = std::make_shared<mu::task_group>(m_settings.max_queue, *m_scheduler);
+    std::vector<std::pair<std::string, RetainedMeshPtr>> retained;
+    try {
+        mes->deserialize(request.stream(), [&](TransformPtr& obj) {
+            // copy before refine. committed only if the whole message is valid.
+            if (mes->use_delta && obj->getType() == Entity::Type::Mesh)
+                retained.emplace_back(obj->path, makeRetainedMesh(static_cast<Mesh&>(*obj)));
+            entity_tasks->run([this, mes, obj]() {
+                convertEntity(*obj, mes->scene.settings);
+            });
+        });
+        mes->timestamp_recv = mu::Now();
+    }
+    catch (const std::exception& e) {
+        // tasks refer the message. let them finish before discarding it.
+        try { entity_tasks->wait(); }
+        catch (...) {}
+        queueTextMessage(e.what(), TextMessage::Type::Error);
+        serveText(response, e.what(), HTTPResponse::HTTP_BAD_REQUEST);
         return;
+    }
 
-    auto task = std::async(std::launch::async, [this, mes]() {
-        // receive and convert assets
-        bool flip_x = mes->scene.settings.handedness == Handedness::Right || mes->scene.settings.handedness == Handedness::RightZUp;
-        bool swap_yz = mes->scene.settings.handedness == Handedness::LeftZUp || mes->scene.settings.handedness == Handedness::RightZUp;
-        parallel_for_each(mes->scene.entities.begin(), mes->scene.entities.end(), [this, &mes, flip_x, swap_yz](TransformPtr& obj) {
-            sanitizeHierarchyPath(obj->path);
-            sanitizeHierarchyPath(obj->reference);
-            if (obj->getType() == Entity::Type::Mesh) {
-                auto& mesh = (Mesh&)*obj;
-                for (auto& bone : mesh.bones)
-                    sanitizeHierarchyPath(bone->path);
-                mesh.refine_settings.scale_factor = 1.0f / mes->scene.settings.scale_factor;
-                mesh.refine_settings.flags.flip_x = flip_x;
-                mesh.refine_settings.flags.flip_yz = swap_yz;
-                mesh.refine_settings.flags.triangulate = 1;
-                mesh.refine_settings.flags.split = 1;
-                mesh.refine_settings.flags.optimize_topology = 1;
-                mesh.refine_settings.split_unit = m_settings.mesh_split_unit;
-                mesh.refine_settings.max_bone_influence = m_settings.mesh_max_bone_influence;
-                mesh.refine(mesh.refine_settings);
+    // retain before responding. the sender may send a delta of these right after.
+    // paths of retained ones are returned. the sender keeps bases of only these.
+    std::string res = "ok";
+    if (!retained.empty()) {
+        lock_t lock(m_retained_mutex);
+        for (auto& r : retained)
+            setRetainedMesh(r.first, r.second);
+        for (auto& r : retained) {
+            if (r.second && m_retained_meshes.find(r.first) != m_retained_meshes.end()) {
+                res += '\n';
+                res += r.first;
             }
-            else {
-                if (flip_x || swap_yz) {
-                    obj->convertHandedness(flip_x, swap_yz);
-                }
-                if (mes->scene.settings.scale_factor != 1.0f) {
-                    float scale = 1.0f / mes->scene.settings.scale_factor;
-                    obj->applyScaleFactor(scale);
-                }
+        }
+    }
+
+    auto task = m_tasks->async([this, mes, entity_tasks]() {
+        entity_tasks->wait();
+        convertAssets(*mes);
+    });
+    queueMessage(mes, std::move(task));
+    serveText(response, res.c_str());
+}
+
+Server::RetainedMeshPtr Server::makeRetainedMesh(Mesh& mesh)
+{
+    // delta is not used for meshes with bones or blend shapes. see Mesh::diff().
+    if (!mesh.bones.empty() || !mesh.blendshapes.empty())
+        return nullptr;
+
+    auto rm = std::make_shared<RetainedMesh>();
+    rm->mesh = std::static_pointer_cast<Mesh>(mesh.clone());
+    rm->checksum = rm->mesh->checksumGeom();
+    return rm;
+}
+
+void Server::setRetainedMesh(const std::string& path, RetainedMeshPtr rm)
+{
+    auto it = m_retained_meshes.find(path);
+    if (it != m_retained_meshes.end()) {
+        m_retained_lru.erase(it->second->lru);
+        if (!rm)
+            m_retained_meshes.erase(it);
+    }
+    if (!rm)
+        return;
+
+    m_retained_lru.push_front(path);
+    rm->lru = m_retained_lru.begin();
+    m_retained_meshes[path] = rm;
+
+    // discard least recently used ones
+    if (m_settings.max_retained_meshes > 0) {
+        while ((int)m_retained_meshes.size() > m_settings.max_retained_meshes) {
+            m_retained_meshes.erase(m_retained_lru.back());
+            m_retained_lru.pop_back();
+        }
+    }
+}
+
+void Server::convertEntity(Transform& obj, const SceneSettings& settings)
+{
+    bool flip_x = settings.handedness == Handedness::Right || settings.handedness == Handedness::RightZUp;
+    bool swap_yz = settings.handedness == Handedness::LeftZUp || settings.handedness == Handedness::RightZUp;
+
+    sanitizeHierarchyPath(obj.path);
+    sanitizeHierarchyPath(obj.reference);
+    if (obj.getType() == Entity::Type::Mesh) {
+        auto& mesh = (Mesh&)obj;
+        for (auto& bone : mesh.bones)
+            sanitizeHierarchyPath(bone->path);
+        mesh.refine_settings.scale_factor = 1.0f / settings.scale_factor;
+        mesh.refine_settings.flags.flip_x = flip_x;
+        mesh.refine_settings.flags.flip_yz = swap_yz;
+        mesh.refine_settings.flags.triangulate = 1;
+        mesh.refine_settings.flags.split = 1;
+        mesh.refine_settings.flags.optimize_topology = 1;
+        mesh.refine_settings.split_unit = m_settings.mesh_split_unit;
+        mesh.refine_settings.max_bone_influence = m_settings.mesh_max_bone_influence;
+        mesh.refine(mesh.refine_settings);
+    }
+    else {
+        if (flip_x || swap_yz) {
+            obj.convertHandedness(flip_x, swap_yz);
+        }
+        if (settings.scale_factor != 1.0f) {
+            float scale = 1.0f / settings.scale_factor;
+            obj.applyScaleFactor(scale);
+        }
+    }
+}
+
+void Server::convertAssets(SetMessage& mes)
+{
+    auto& settings = mes.scene.settings;
+    bool flip_x = settings.handedness == Handedness::Right || settings.handedness == Handedness::RightZUp;
+    bool swap_yz = settings.handedness == Handedness::LeftZUp || settings.handedness == Handedness::RightZUp;
+
+    for (auto& asset : mes.scene.assets) {
+        if (asset->getAssetType() != AssetType::Animation)
+            continue;
+
+        auto clip = std::static_pointer_cast<AnimationClip>(asset);
+        parallel_for_each(clip->animations.begin(), clip->animations.end(), [&](AnimationPtr& anim) {
+            sanitizeHierarchyPath(anim->path);
+            if (flip_x || swap_yz) {
+                anim->convertHandedness(flip_x, swap_yz);
+            }
+            if (settings.scale_factor != 1.0f) {
+                float scale = 1.0f / settings.scale_factor;
+                anim->applyScaleFactor(scale);
             }
             });
-        for (auto& asset : mes->scene.assets) {
-            if (asset->getAssetType() != AssetType::Animation)
-                continue;
-
-            auto clip = std::static_pointer_cast<AnimationClip>(asset);
-            parallel_for_each(clip->animations.begin(), clip->animations.end(), [this, &mes, flip_x, swap_yz](AnimationPtr& anim) {
-                sanitizeHierarchyPath(anim->path);
-                if (flip_x || swap_yz) {
-                    anim->convertHandedness(flip_x, swap_yz);
-                }
-                if (mes->scene.settings.scale_factor != 1.0f) {
-                    float scale = 1.0f / mes->scene.settings.scale_factor;
-                    anim->applyScaleFactor(scale);
-                }
-                });
-        }
+    }
+}
+
+void Server::queueSetMessage(SetMessagePtr mes)
+{
+    auto task = m_tasks->async([this, mes]() {
+        parallel_for_each(mes->scene.entities.begin(), mes->scene.entities.end(), [this, &mes](TransformPtr& obj) {
+            convertEntity(*obj, mes->scene.settings);
+            });
+        convertAssets(*mes);
     });
     queueMessage(mes, std::move(task));
-    serveText(response, "ok");
 }
 
 void Server::recvDelete(HTTPServerRequest& request, HTTPServerResponse& response)
@@ -535,10 +680,78 @@ void Server::recvDelete(HTTPServerRequest& request, HTTPServerResponse& response
     auto mes = deserializeMessage<DeleteMessage>(request, response);
     if (!mes)
         return;
+    {
+        lock_t lock(m_retained_mutex);
+        for (auto& id : mes->entities)
+            setRetainedMesh(id.name, nullptr);
+    }
     queueMessage(mes);
     serveText(response, "ok");
 }
 
+void Server::recvDelta(HTTPServerRequest& request, HTTPServerResponse& response)
+{
+    auto mes = deserializeMessage<DeltaMessage>(request, response);
+    if (!mes)
+        return;
+
+    auto& delta = mes->delta;
+    if (!delta.transform) {
+        serveText(response, "", HTTPResponse::HTTP_BAD_REQUEST);
+        return;
+    }
+
+    auto& path = delta.transform->path;
+    RetainedMeshPtr rm;
+    {
+        lock_t lock(m_retained_mutex);
+        auto it = m_retained_meshes.find(path);
+        if (it != m_retained_meshes.end()) {
+            rm = it->second;
+            m_retained_lru.splice(m_retained_lru.begin(), m_retained_lru, rm->lru);
+        }
+    }
+
+    MeshPtr mesh;
+    bool broken = false;
+    if (rm) {
+        // deltas of other meshes are patched in parallel. only deltas of the same mesh wait here.
+        lock_t lock(rm->mutex);
+        if (rm->checksum == delta.base_checksum) {
+            if (rm->mesh->patch(delta)) {
+                rm->checksum = delta.checksum;
+                mesh = std::static_pointer_cast<Mesh>(rm->mesh->clone());
+            }
+            else {
+                // partially patched. can't be a base anymore.
+                broken = true;
+            }
+        }
+    }
+    if (broken) {
+        lock_t lock(m_retained_mutex);
+        auto it = m_retained_meshes.find(path);
+        if (it != m_retained_meshes.end() && it->second == rm)
+            setRetainedMesh(path, nullptr);
+    }
+    if (!mesh) {
+        // the sender will send the whole mesh
+        serveText(response, "base mesh mismatch", HTTPResponse::HTTP_CONFLICT);
+        return;
+    }
+
+    // handle as if the whole mesh is received
+    auto set = std::make_shared<SetMessage>();
+    set->session_id = mes->session_id;
+    set->message_id = mes->message_id;
+    set->timestamp_send = mes->timestamp_send;
+    set->timestamp_recv = mes->timestamp_recv;
+    set->scene.settings = mes->scene_settings;
+    set->scene.entities = { mesh };
+    queueSetMessage(set);
+    serveText(response, "ok");
+}
+
 void Server::recvFence(HTTPServerRequest& request, HTTPServerResponse& response)
 {
     auto mes = deserializeMessage<FenceMessage>(request, response);
@@ -557,32 +770,29 @@ void Server::recvGet(HTTPServerRequest& request, HTTPServerResponse& response)
     queueMessage(mes);
 
     // wait for data arrive (or timeout)
-    for (int i = 0; i < 300; ++i) {
-        if (mes->ready)
-            break;
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-    }
+    mes->ready.wait(m_settings.request_timeout_ms);
 
     // serve data
     {
-        lock_t l(m_message_mutex);
-        if (m_host_scene) {
-            response.setContentType("application/octet-stream");
-            response.setContentLength(ssize(*m_host_scene));
-
-            auto& os = response.send();
-            m_host_scene->serialize(os);
-            os.flush();
+        // serialize once into a buffer. the size is known after that, so no ssize() pass is needed.
+        // take a reference and serialize it without lock. m_host_scene is replaced only by a complete scene (see endServeScene()).
+        ScenePtr scene;
+        {
+            lock_t lock(m_host_scene_mutex);
+            scene = m_host_scene;
+        }
+
+        MemoryStream buf;
+        if (scene) {
+            scene->serialize(buf);
         }
         else {
             Scene empty_scene;
-            response.setContentType("application/octet-stream");
-            response.setContentLength(ssize(empty_scene));
-
-            auto& os = response.send();
-            empty_scene.serialize(os);
-            os.flush();
+            empty_scene.serialize(buf);
         }
+        buf.flush();
+        auto& data = buf.getBuffer();
+        serveBinary(response, data.data(), data.size());
     }
 }
 
@@ -604,25 +814,17 @@ void Server::recvQuery(HTTPServerRequest& request, HTTPServerResponse& response)
         queueMessage(mes);
 
         // wait for data arrive (or timeout)
-        for (int i = 0; i < 300; ++i) {
-            if (mes->ready)
-                break;
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-        }
+        mes->ready.wait(m_settings.request_timeout_ms);
     }
 
     // serve data
     {
-        response.setContentType("application/octet-stream");
-        auto& os = response.send();
-        if (mes->response) {
-            response.setContentLength(ssize(*mes->response));
-            mes->response->serialize(os);
-        }
-        else {
-            response.setContentLength(0);
-        }
-        os.flush();
+        MemoryStream buf;
+        if (mes->response)
+            mes->response->serialize(buf);
+        buf.flush();
+        auto& data = buf.getBuffer();
+        serveBinary(response, data.data(), data.size());
         mes->response.reset();
     }
 }
@@ -675,11 +877,7 @@ void Server::recvScreenshot(HTTPServerRequest& /*request*/, HTTPServerResponse&
     queueMessage(mes);
 
     // wait for data arrive (or timeout)
-    for (int i = 0; i < 300; ++i) {
-        if (mes->ready)
-            break;
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-    }
+    mes->ready.wait(m_settings.request_timeout_ms);
 
     // serve data
     response.set("Cache-Control", "no-store, must-revalidate");
@@ -705,15 +903,10 @@ void Server::recvPoll(HTTPServerRequest& request, HTTPServerResponse& response)
     }
 
     // wait for data arrive (or timeout)
-    for (int i = 0; i < 400; ++i) {
-        if (mes->ready) {
-            break;
-        }
-        std::this_thread::sleep_for(std::chrono::milliseconds(25));
-    }
+    bool ready = mes->ready.wait(m_settings.poll_timeout_ms);
 
     // serve data
-    if (mes->ready) {
+    if (ready) {
         serveText(response, "ok", HTTPResponse::HTTP_OK);
     }
     else {
@@ -726,7 +919,7 @@ void Server::notifyPoll(PollMessage::PollType t)
     lock_t lock(m_poll_mutex);
     for (auto& p : m_polls) {
         if (p->poll_type == t) {
-            p->ready = true;
+            p->ready.set();
             p.reset();
         }
     }
@@ -738,10 +931,16 @@ Server::MessageHolder::MessageHolder()
 }
 
 Server::MessageHolder::MessageHolder(MessageHolder && v)
+{
+    *this = std::move(v);
+}
+
+Server::MessageHolder& Server::MessageHolder::operator=(MessageHolder && v)
 {
     message = std::move(v.message);
     task = std::move(v.task);
     ready = v.ready.load();
+    return *this;
 }
 
 } // namespace ms
@@ -20,10 +20,13 @@ namespace ms {
 struct ServerSettings
 {
     int max_queue = 256;
-    int max_threads = 8;
+    int max_threads = 8; // HTTP connection threads, and worker threads that convert received messages
     uint16_t port = 8080;
     uint32_t mesh_split_unit = 0xffffffff;
     int mesh_max_bone_influence = 4; // -1 (variable) or 4
+    int request_timeout_ms = 3000; // get, query and screenshot
+    int poll_timeout_ms = 10000;
+    int max_retained_meshes = 1024; // base meshes of DeltaMessage. least recently used ones are discarded beyond this. 0: unlimited
 };
 
 class Server
@@ -38,8 +41,10 @@ public:
     ServerSettings& getSettings();
 
     using MessageHandler = std::function<void(Message::Type type, Message& data)>;
+    // register a handler for specific message type. processMessages() uses it instead of the handler passed to it.
+    void setMessageHandler(Message::Type type, const MessageHandler& handler);
     int getNumMessages() const;
-    int processMessages(const MessageHandler& handler);
+    int processMessages(const MessageHandler& handler = {});
 
     void serveText(Poco::Net::HTTPServerResponse &response, const char* text, int stat = 200);
     void serveBinary(Poco::Net::HTTPServerResponse &response, const void *data, size_t size, int stat = 200);
@@ -66,12 +71,15 @@ public:
 
         MessageHolder();
         MessageHolder(MessageHolder&& v);
+        MessageHolder& operator=(MessageHolder&& v);
     };
 
+    // the scene being built between beginServeScene() and endServeScene(). null otherwise.
     Scene* getHostScene();
     void queueTextMessage(const char *mes, TextMessage::Type type);
     void recvSet(Poco::Net::HTTPServerRequest& request, Poco::Net::HTTPServerResponse& response);
     void recvDelete(Poco::Net::HTTPServerRequest& request, Poco::Net::HTTPServerResponse& response);
+    void recvDelta(Poco::Net::HTTPServerRequest& request, Poco::Net::HTTPServerResponse& response);
     void recvFence(Poco::Net::HTTPServerRequest& request, Poco::Net::HTTPServerResponse& response);
     void recvGet(Poco::Net::HTTPServerRequest& request, Poco::Net::HTTPServerResponse& response);
     void recvQuery(Poco::Net::HTTPServerRequest& request, Poco::Net::HTTPServerResponse& response);
@@ -85,8 +93,14 @@ private:
     template<class MessageT>
     std::shared_ptr<MessageT> deserializeMessage(Poco::Net::HTTPServerRequest& request, Poco::Net::HTTPServerResponse& response);
 
-    MessageHolder* queueMessage(MessagePtr mes);
-    MessageHolder* queueMessage(MessagePtr mes, std::future<void>&& task);
+    void dispatch(const MessageHandler& handler, Message& mes);
+    void queueMessage(MessagePtr mes);
+    void queueMessage(MessagePtr mes, std::future<void>&& task);
+    // convert received scene on the task pool and queue it
+    void queueSetMessage(SetMessagePtr mes);
+    // handedness, scale and mesh refinement
+    void convertEntity(Transform& obj, const SceneSettings& settings);
+    void convertAssets(SetMessage& mes);
 
     bool loadMIMETypes(const std::string& path);
     const std::string& getMIMEType(const std::string& filename);
@@ -100,19 +114,47 @@ private:
     ServerSettings m_settings;
     HTTPServerPtr m_server;
     std::map<std::string, std::string> m_mimetypes;
-    std::mutex m_message_mutex;
+    std::mutex m_host_scene_mutex;
     std::mutex m_poll_mutex;
 
     int m_current_scene_session = InvalidID;
-    std::list<MessageHolder> m_received_messages, m_processing_messages;
-    std::vector<SetMessagePtr> m_scene_cache;
+    // pushed by server threads, popped by the thread calling processMessages()
+    mu::mpsc_queue<MessageHolder> m_received_messages;
+    std::list<MessageHolder> m_processing_messages;
+    std::vector<MessagePtr> m_scene_cache;
+    std::vector<MessageHandler> m_message_handlers;
     PollMessages m_polls;
 
-    ScenePtr m_host_scene;
-    GetMessagePtr m_current_get_request;
+    // meshes as received (before refine). base of DeltaMessage.
+    // kept only for senders that use deltas (SetMessage::use_delta), up to max_retained_meshes.
+    struct RetainedMesh
+    {
+        std::mutex mutex; // patch and clone by recvDelta() run under this, not m_retained_mutex
+        MeshPtr mesh;
+        uint64_t checksum = 0;
+        std::list<std::string>::iterator lru; // position in m_retained_lru. guarded by m_retained_mutex
+    };
+    using RetainedMeshPtr = std::shared_ptr<RetainedMesh>;
+    // null if the mesh can't be a base of deltas
+    static RetainedMeshPtr makeRetainedMesh(Mesh& mesh);
+    // m_retained_mutex must be locked. null rm erases the entry.
+    void setRetainedMesh(const std::string& path, RetainedMeshPtr rm);
+
+    std::mutex m_retained_mutex;
+    std::map<std::string, RetainedMeshPtr> m_retained_meshes;
+    std::list<std::string> m_retained_lru; // paths of m_retained_meshes. most recently used first
+
+    ScenePtr m_host_scene;    // complete scene served to Get requests. guarded by m_host_scene_mutex
+    ScenePtr m_serving_scene; // being built. accessed only by the thread calling processMessages()
+    GetMessage *m_current_get_request = nullptr; // valid only while the Get handler is running
     ScreenshotMessagePtr m_current_screenshot_request;
     std::string m_screenshot_file_path;
     std::string m_file_root_path;
+
+    // conversion tasks of received messages run on max_threads workers of the server's own.
+    // declared last to be destroyed (and waited) first. m_tasks before m_scheduler.
+    std::unique_ptr<mu::task_scheduler> m_scheduler;
+    std::unique_ptr<mu::task_group> m_tasks;
 };
 msDeclPtr(Server);
 
@@ -394,9 +394,7 @@ msmaxContext::TreeNode & msmaxContext::getNodeRecord(INode *n)
 
 void msmaxContext::kickAsyncSend()
 {
-    for (auto& t : m_async_tasks)
-        t.wait();
-    m_async_tasks.clear();
+    m_async_tasks.wait();
 
     for (auto *t : m_tmp_meshes)
         t->DeleteThis();
@@ -885,7 +883,7 @@ ms::MeshPtr msmaxContext::exportMesh(TreeNode& n)
     };
 
     if (m_settings.multithreaded)
-        m_async_tasks.push_back(std::async(std::launch::async, task));
+        m_async_tasks.run(task);
     else
         task();
 
@@ -161,7 +161,7 @@ private:
 
     std::map<INode*, TreeNode> m_node_records;
     std::map<Mtl*, MaterialRecord> m_material_records;
-    std::vector<std::future<void>> m_async_tasks;
+    mu::task_group m_async_tasks;
     std::vector<TriObject*> m_tmp_meshes;
 
     int m_index_seed = 0;
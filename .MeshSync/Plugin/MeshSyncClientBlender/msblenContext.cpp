@@ -395,7 +395,7 @@ ms::MeshPtr msblenContext::exportMesh(Object *src)
     };
 
     if(m_settings.multithreaded)
-        m_async_tasks.push_back(std::async(std::launch::async, task));
+        m_async_tasks.run(task);
     else
         task();
     return ret;
@@ -1169,9 +1169,7 @@ void msblenContext::flushPendingList()
 
 void msblenContext::kickAsyncSend()
 {
-    for (auto& t : m_async_tasks)
-        t.wait();
-    m_async_tasks.clear();
+    m_async_tasks.wait();
 
     // clear baked meshes
     if (!m_tmp_meshes.empty()) {
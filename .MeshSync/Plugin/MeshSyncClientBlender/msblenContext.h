@@ -136,7 +136,7 @@ private:
     std::set<Object*> m_pending;
     std::map<Bone*, ms::TransformPtr> m_bones;
     std::map<void*, ObjectRecord> m_obj_records; // key can be object or bone
-    std::vector<std::future<void>> m_async_tasks;
+    mu::task_group m_async_tasks;
     std::vector<Mesh*> m_tmp_meshes;
 
     std::vector<ms::AnimationClipPtr> m_animations;
@@ -4,6 +4,12 @@
 #include "msxmContext.h"
 
 
+// mesh data of buffers are built on the shared task scheduler
+static mu::task_group& GetBuildTasks()
+{
+    static mu::task_group s_tasks;
+    return s_tasks;
+}
 
 int msxmGetXismoVersion()
 {
@@ -104,7 +110,7 @@ void BufferRecord::startBuildMeshData(const msxmSettings& settings)
         dirty = false;
         vertices_tmp.resize_discard(num_elements);
         data.copy_to((char*)vertices_tmp.data());
-        task = std::async(std::launch::async, [this, &settings]() {
+        task = GetBuildTasks().async([this, &settings]() {
             buildMeshDataBody(settings);
         });
     }
@@ -320,7 +320,7 @@ msAPI ms::QueryMessage::QueryType msQueryGetType(ms::QueryMessage *self)
 }
 msAPI void msQueryFinishRespond(ms::QueryMessage *self)
 {
-    self->ready = true;
+    self->ready.set();
 }
 msAPI void msQueryAddResponseText(ms::QueryMessage *self, const char *text)
 {
@@ -40,7 +40,14 @@ void GenerateNormalsWithSmoothAngle(RawVector<float3>& dst,
     const IArray<float3> points, const IArray<int> counts, const IArray<int> indices, float smooth_angle, bool flip)
 {
     MeshConnectionInfo connection;
-    connection.buildConnection(indices, counts, points);
+    GenerateNormalsWithSmoothAngle(dst, points, counts, indices, smooth_angle, flip, connection);
+}
+
+void GenerateNormalsWithSmoothAngle(RawVector<float3>& dst,
+    const IArray<float3> points, const IArray<int> counts, const IArray<int> indices, float smooth_angle, bool flip,
+    MeshConnectionInfo& connection)
+{
+    connection.ensureConnection(indices, counts, points);
 
     const size_t num_faces = counts.size();
     const int i1 = flip ? 2 : 1;
@@ -102,6 +109,16 @@ void GenerateNormalsWithSmoothAngle(RawVector<float3>& dst,
 void QuadifyTriangles(const IArray<float3> points, const IArray<int> indices, bool full_search, float threshold_angle,
     RawVector<int>& dst_indices, RawVector<int>& dst_counts)
 {
+    MeshConnectionInfo connection;
+    QuadifyTriangles(points, indices, full_search, threshold_angle, dst_indices, dst_counts, connection);
+}
+
+void QuadifyTriangles(const IArray<float3> points, const IArray<int> indices, bool full_search, float threshold_angle,
+    RawVector<int>& dst_indices, RawVector<int>& dst_counts, MeshConnectionInfo& connection)
+{
+    if (full_search)
+        connection.ensureConnection(indices, 3, points);
+
     struct Connection
     {
         int nindex;
@@ -153,25 +170,15 @@ void QuadifyTriangles(const IArray<float3> points, const IArray<int> indices, bo
         auto *tri1 = indices.data() + (ti1 * 3);
         const float3 normal1 = normalize(cross(points[tri1[1]] - points[tri1[0]], points[tri1[2]] - points[tri1[0]]));
 
-        int ti2begin, ti2end;
-        if (full_search) {
-            ti2begin = std::max(ti1 - 1, 0);
-            ti2end = num_triangles;
-        }
-        else {
-            ti2begin = std::max(ti1 - 1, 0);
-            ti2end = std::min(ti1 + 2, num_triangles);
-        }
-
-        for (int ti2 = ti2begin; ti2 != ti2end; ++ti2) {
+        auto search = [&](int ti2) {
             auto *tri2 = indices.data() + (ti2 * 3);
 
             if (overlapped(tri1, tri2) != 2)
-                continue;
+                return;
 
             float3 normal2 = normalize(cross(points[tri2[1]] - points[tri2[0]], points[tri2[2]] - points[tri2[0]]));
             if (dot(normal1, normal2) < 0.0f)
-                continue;
+                return;
 
             int quad[6];
             std::copy(tri1, tri1 + 3, quad);
@@ -224,6 +231,36 @@ void QuadifyTriangles(const IArray<float3> points, const IArray<int> indices, bo
                 cd.nangle = diff;
                 std::copy(quad_tmp, quad_tmp + 4, cd.quad);
             }
+        };
+
+        int ti2begin = std::max(ti1 - 1, 0);
+        if (full_search) {
+            // candidates share vertices with tri1. lists of connected faces are sorted by face index,
+            // so merging them gives the same search order as a linear search.
+            const int *fcur[3], *fend[3];
+            for (int i = 0; i < 3; ++i) {
+                fcur[i] = connection.v2f_faces.data() + connection.v2f_offsets[tri1[i]];
+                fend[i] = fcur[i] + connection.v2f_counts[tri1[i]];
+            }
+            int prev = -1;
+            for (;;) {
+                int k = -1;
+                for (int i = 0; i < 3; ++i) {
+                    if (fcur[i] != fend[i] && (k == -1 || *fcur[i] < *fcur[k]))
+                        k = i;
+                }
+                if (k == -1)
+                    break;
+                int ti2 = *fcur[k]++;
+                if (ti2 >= ti2begin && ti2 != prev)
+                    search(ti2);
+                prev = ti2;
+            }
+        }
+        else {
+            int ti2end = std::min(ti1 + 2, num_triangles);
+            for (int ti2 = ti2begin; ti2 != ti2end; ++ti2)
+                search(ti2);
         }
     });
 
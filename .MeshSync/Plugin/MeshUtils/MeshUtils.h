@@ -16,6 +16,8 @@
 #include "muMisc.h"
 #include "muConcurrency.h"
 #include "muCompression.h"
+#include "muHash.h"
+#include "muHashMap.h"
 
 namespace mu {
 
@@ -28,6 +30,11 @@ void GenerateNormalsWithSmoothAngle(RawVector<float3>& dst,
     const IArray<float3> points,
     const IArray<int> counts, const IArray<int> indices,
     float smooth_angle, bool flip);
+// connection is built only if it is not built for this mesh yet (see MeshConnectionInfo::ensureConnection())
+void GenerateNormalsWithSmoothAngle(RawVector<float3>& dst,
+    const IArray<float3> points,
+    const IArray<int> counts, const IArray<int> indices,
+    float smooth_angle, bool flip, MeshConnectionInfo& connection);
 
 
 // PointsIter: indexed_iterator<const float3*, int*> or indexed_iterator_s<const float3*, int*>
@@ -46,6 +53,9 @@ void GenerateTangentsPoly(float4 *dst,
 
 void QuadifyTriangles(const IArray<float3> vertices, const IArray<int> triangle_indices, bool full_search, float threshold_angle,
     RawVector<int>& dst_indices, RawVector<int>& dst_counts);
+// full search looks up neighbor triangles with connection. it is built only if it is not built for this mesh yet.
+void QuadifyTriangles(const IArray<float3> vertices, const IArray<int> triangle_indices, bool full_search, float threshold_angle,
+    RawVector<int>& dst_indices, RawVector<int>& dst_counts, MeshConnectionInfo& connection);
 
 template<class Handler>
 void SelectEdge(const IArray<int>& indices, int ngon, const IArray<float3>& vertices,
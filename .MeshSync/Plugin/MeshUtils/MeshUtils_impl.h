@@ -1,6 +1,7 @@
 #pragma once
 
 #include "muMeshRefiner.h"
+#include "muHashMap.h"
 
 namespace mu {
 namespace impl {
@@ -80,8 +81,24 @@ inline void BuildConnection(
     }
 }
 
+// key of the spatial hash to find vertices at the same or near positions
+struct WeldKey
+{
+    int64_t x, y, z;
+    bool operator==(const WeldKey& v) const { return x == v.x && y == v.y && z == v.z; }
+};
+struct WeldKeyHasher
+{
+    uint64_t operator()(const WeldKey& v) const
+    {
+        return (uint64_t)v.x * 0x9E3779B185EBCA87ULL ^ (uint64_t)v.y * 0xC2B2AE3D27D4EB4FULL ^ (uint64_t)v.z * 0x165667B19E3779F9ULL;
+    }
+};
+
+// weld_map[vi] is the first vertex at the same position as vi (or within epsilon if epsilon > 0).
+// it is always a root: weld_map[weld_map[vi]] == weld_map[vi].
 inline void BuildWeldMap(
-    MeshConnectionInfo& connection, const IArray<float3>& vertices)
+    MeshConnectionInfo& connection, const IArray<float3>& vertices, float epsilon = 0.0f)
 {
     auto& weld_map = connection.weld_map;
     auto& weld_counts = connection.weld_counts;
@@ -94,17 +111,71 @@ inline void BuildWeldMap(
     weld_offsets.resize_discard(n);
     weld_indices.resize_discard(n);
 
-    parallel_for(0, n, [&](int vi) {
-        int r = vi;
-        float3 p = vertices[vi];
-        for (int i = 0; i < vi; ++i) {
-            if (vertices[i] == p) {
-                r = i;
-                break;
+    if (epsilon <= 0.0f) {
+        // exact match. -0.0 is same as 0.0. NaN never matches, as operator== does.
+        auto to_key = [](float v) -> int64_t {
+            float t = v == 0.0f ? 0.0f : v;
+            uint32_t bits;
+            memcpy(&bits, &t, sizeof(bits));
+            return bits;
+        };
+        flat_hash_map<WeldKey, int, WeldKeyHasher> first;
+        first.reserve(n);
+        for (int vi = 0; vi < n; ++vi) {
+            float3 p = vertices[vi];
+            WeldKey key{ to_key(p.x), to_key(p.y), to_key(p.z) };
+            if (auto *r = first.find(key))
+                weld_map[vi] = vertices[*r] == p ? *r : vi;
+            else {
+                first[key] = vi;
+                weld_map[vi] = vi;
+            }
+        }
+    }
+    else {
+        // grid of epsilon sized cells. vertices within epsilon are in the same or adjacent cells.
+        // vertices in each cell are linked in ascending order, so the first match in a cell is the smallest index in it.
+        struct Cell { int head = -1, tail = -1; };
+        flat_hash_map<WeldKey, Cell, WeldKeyHasher> cells;
+        cells.reserve(n);
+        RawVector<int> next;
+        next.resize_discard(n);
+
+        float rcp = 1.0f / epsilon;
+        float eps2 = epsilon * epsilon;
+        for (int vi = 0; vi < n; ++vi) {
+            float3 p = vertices[vi];
+            WeldKey key{ (int64_t)std::floor(p.x * rcp), (int64_t)std::floor(p.y * rcp), (int64_t)std::floor(p.z * rcp) };
+
+            int r = vi;
+            for (int64_t z = -1; z <= 1; ++z) {
+                for (int64_t y = -1; y <= 1; ++y) {
+                    for (int64_t x = -1; x <= 1; ++x) {
+                        auto *cell = cells.find({ key.x + x, key.y + y, key.z + z });
+                        if (!cell)
+                            continue;
+                        for (int i = cell->head; i != -1 && i < r; i = next[i]) {
+                            if (length_sq(vertices[i] - p) <= eps2) {
+                                r = i;
+                                break;
+                            }
+                        }
+                    }
+                }
             }
+            // weld to the root of the match, so that weld_map[weld_map[vi]] == weld_map[vi] even on chains
+            // of vertices where each is within epsilon of the previous one.
+            weld_map[vi] = r == vi ? vi : weld_map[r];
+
+            auto& cell = cells[key];
+            next[vi] = -1;
+            if (cell.tail != -1)
+                next[cell.tail] = vi;
+            else
+                cell.head = vi;
+            cell.tail = vi;
         }
-        weld_map[vi] = r;
-    });
+    }
 
     weld_counts.zeroclear();
     for (int vi : weld_map) {
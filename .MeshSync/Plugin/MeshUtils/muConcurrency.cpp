@@ -0,0 +1,400 @@
+#include "pch.h"
+#include "muConcurrency.h"
+
+namespace mu {
+
+thread_pool::thread_pool(int num_threads, int max_queue)
+    : m_max_queue(max_queue > 0 ? (size_t)max_queue : 0)
+{
+    if (num_threads <= 0)
+        num_threads = std::max<int>(std::thread::hardware_concurrency(), 1);
+    for (int i = 0; i < num_threads; ++i)
+        m_threads.emplace_back([this]() { process(); });
+}
+
+thread_pool::~thread_pool()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cond_pop.notify_all();
+    m_cond_push.notify_all();
+    for (auto& t : m_threads)
+        t.join();
+}
+
+std::future<void> thread_pool::push(const task_t& task)
+{
+    std::packaged_task<void()> t(task);
+    auto ret = t.get_future();
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_max_queue > 0)
+            m_cond_push.wait(lock, [this]() { return m_stop || m_tasks.size() < m_max_queue; });
+        if (m_stop) {
+            // pool is being destroyed. run on the caller's thread.
+            lock.unlock();
+            t();
+            return ret;
+        }
+        m_tasks.push_back(std::move(t));
+    }
+    m_cond_pop.notify_one();
+    return ret;
+}
+
+int thread_pool::getNumThreads() const
+{
+    return (int)m_threads.size();
+}
+
+int thread_pool::getNumQueued()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return (int)m_tasks.size();
+}
+
+void thread_pool::process()
+{
+    for (;;) {
+        std::packaged_task<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond_pop.wait(lock, [this]() { return m_stop || !m_tasks.empty(); });
+            if (m_tasks.empty())
+                break; // m_stop && nothing left
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        m_cond_push.notify_one();
+        task();
+    }
+}
+
+
+// scheduler and worker index of the calling thread
+static thread_local task_scheduler *g_current_scheduler = nullptr;
+static thread_local int g_worker_index = -1;
+
+task_scheduler& task_scheduler::instance()
+{
+    // intentionally leaked. joining workers in static destructors can deadlock on DLL unload.
+    static task_scheduler *s_instance = new task_scheduler();
+    return *s_instance;
+}
+
+task_scheduler::task_scheduler(int num_threads)
+{
+    if (num_threads <= 0)
+        num_threads = std::max<int>(std::thread::hardware_concurrency(), 1);
+    for (int i = 0; i < num_threads; ++i)
+        m_queues.emplace_back(new task_queue());
+    for (int i = 0; i < num_threads; ++i)
+        m_threads.emplace_back([this, i]() { process(i); });
+}
+
+task_scheduler::~task_scheduler()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cond.notify_all();
+    for (auto& t : m_threads)
+        t.join();
+}
+
+void task_scheduler::push(task_t&& task)
+{
+    auto& queue = g_current_scheduler == this ? *m_queues[g_worker_index] : m_shared_queue;
+    {
+        spin_mutex::lock_t lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    ++m_num_queued;
+
+    // workers increment m_num_sleeping before checking m_num_queued. one of them sees the other.
+    if (m_num_sleeping > 0) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cond.notify_one();
+    }
+}
+
+bool task_scheduler::pop(task_t& dst)
+{
+    if (m_num_queued <= 0)
+        return false;
+
+    auto try_pop = [&](task_queue& queue, bool back) {
+        spin_mutex::lock_t lock(queue.mutex);
+        if (queue.tasks.empty())
+            return false;
+        if (back) {
+            dst = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        else {
+            dst = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        --m_num_queued;
+        return true;
+    };
+
+    int self = g_current_scheduler == this ? g_worker_index : -1;
+    if (self >= 0 && try_pop(*m_queues[self], true))
+        return true;
+    if (try_pop(m_shared_queue, false))
+        return true;
+
+    // steal
+    int n = (int)m_queues.size();
+    int first = self >= 0 ? self + 1 : 0;
+    for (int i = 0; i < n; ++i) {
+        int victim = (first + i) % n;
+        if (victim != self && try_pop(*m_queues[victim], false))
+            return true;
+    }
+    return false;
+}
+
+bool task_scheduler::run_one()
+{
+    task_t task;
+    if (!pop(task))
+        return false;
+    task();
+    return true;
+}
+
+bool task_scheduler::is_worker() const
+{
+    return g_current_scheduler == this;
+}
+
+int task_scheduler::getNumThreads() const
+{
+    return (int)m_threads.size();
+}
+
+void task_scheduler::process(int index)
+{
+    g_current_scheduler = this;
+    g_worker_index = index;
+
+    const int spin_count = 64;
+    for (;;) {
+        task_t task;
+        bool found = false;
+        for (int i = 0; i < spin_count && !found; ++i) {
+            found = pop(task);
+            if (!found)
+                std::this_thread::yield();
+        }
+        if (found) {
+            task();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        ++m_num_sleeping;
+        m_cond.wait(lock, [this]() { return m_stop || m_num_queued > 0; });
+        --m_num_sleeping;
+        if (m_stop && m_num_queued <= 0)
+            break;
+    }
+
+    g_current_scheduler = nullptr;
+    g_worker_index = -1;
+}
+
+
+task_group::task_group(int max_pending, task_scheduler& scheduler)
+    : m_scheduler(scheduler)
+    , m_max_pending(max_pending)
+{
+}
+
+task_group::~task_group()
+{
+    try {
+        wait();
+    }
+    catch (...) {
+    }
+}
+
+void task_group::run(task_t task)
+{
+    if (m_max_pending > 0)
+        wait_pending(m_max_pending - 1);
+
+    ++m_pending;
+    m_scheduler.push([this, task = std::move(task)]() {
+        try {
+            task();
+        }
+        catch (...) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (!m_exception)
+                m_exception = std::current_exception();
+        }
+        finish();
+    });
+}
+
+std::future<void> task_group::async(task_t task)
+{
+    // std::function requires copyable callables
+    auto t = std::make_shared<std::packaged_task<void()>>(std::move(task));
+    auto ret = t->get_future();
+    run([t]() { (*t)(); });
+    return ret;
+}
+
+void task_group::wait()
+{
+    wait_pending(0);
+
+    // finish() of the last task may be still holding the lock
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_exception) {
+        auto e = m_exception;
+        m_exception = nullptr;
+        lock.unlock();
+        std::rethrow_exception(e);
+    }
+}
+
+int task_group::getNumPending() const
+{
+    return m_pending;
+}
+
+void task_group::wait_pending(int n)
+{
+    if (m_scheduler.is_worker()) {
+        // blocking a worker can starve the tasks being waited. help others instead.
+        while (m_pending > n) {
+            if (!m_scheduler.run_one())
+                std::this_thread::yield();
+        }
+        return;
+    }
+
+    // other threads (main thread, request handlers, etc) never run tasks of others.
+    // they may hold locks the tasks need, and should not take the latency of unrelated tasks.
+    std::unique_lock<std::mutex> lock(m_mutex);
+    ++m_num_waiting;
+    m_cond.wait(lock, [this, n]() { return m_pending <= n; });
+    --m_num_waiting;
+}
+
+void task_group::finish()
+{
+    // decrement under the lock. wait() takes it before return, so the group is alive until this returns.
+    std::unique_lock<std::mutex> lock(m_mutex);
+    --m_pending;
+    if (m_num_waiting > 0)
+        m_cond.notify_all();
+}
+
+
+#if !defined(muEnablePPL) && !defined(muEnableTBB)
+
+// shared with helper tasks. helpers that start after all blocks are taken just return, so they may outlive the call.
+struct parallel_for_state
+{
+    std::atomic<int> next{ 0 }; // index of the next block to take
+    std::atomic<int> active{ 0 }; // number of helpers that may be in body
+    int num_blocks = 0;
+    int begin = 0, end = 0, granularity = 0;
+    const std::function<void(int, int)> *body = nullptr;
+    std::mutex mutex;
+    std::condition_variable cond; // notified when active becomes 0
+    std::exception_ptr exception;
+
+    void leave()
+    {
+        // decrement under the lock. the caller checks active under it before sleeping.
+        std::unique_lock<std::mutex> lock(mutex);
+        if (--active == 0)
+            cond.notify_all();
+    }
+
+    void process()
+    {
+        for (;;) {
+            int i = next++;
+            if (i >= num_blocks)
+                break;
+            int b = begin + granularity * i;
+            int e = std::min(b + granularity, end);
+            try {
+                (*body)(b, e);
+            }
+            catch (...) {
+                next = num_blocks; // cancel remaining blocks
+                std::unique_lock<std::mutex> lock(mutex);
+                if (!exception)
+                    exception = std::current_exception();
+            }
+        }
+    }
+};
+
+void parallel_for_impl(int begin, int end, int granularity, const std::function<void(int, int)>& body)
+{
+    int num_elements = end - begin;
+    if (num_elements <= 0)
+        return;
+
+    auto& scheduler = task_scheduler::instance();
+    int num_threads = scheduler.getNumThreads();
+    if (granularity <= 0) {
+        // some blocks per thread to balance uneven loads
+        const int blocks_per_thread = 4;
+        granularity = std::max((num_elements + num_threads * blocks_per_thread - 1) / (num_threads * blocks_per_thread), 1);
+    }
+    int num_blocks = (num_elements + granularity - 1) / granularity;
+    if (num_blocks == 1) {
+        body(begin, end);
+        return;
+    }
+
+    auto state = std::make_shared<parallel_for_state>();
+    state->num_blocks = num_blocks;
+    state->begin = begin;
+    state->end = end;
+    state->granularity = granularity;
+    state->body = &body;
+
+    int num_helpers = std::min(num_blocks - 1, num_threads);
+    for (int i = 0; i < num_helpers; ++i) {
+        scheduler.push([state]() {
+            // increment active before taking a block. the caller sees it if this takes one.
+            ++state->active;
+            state->process();
+            state->leave();
+        });
+    }
+    state->process();
+
+    // all blocks are taken. wait for ones being processed by helpers.
+    // spin briefly as short blocks are likely to be done soon, then sleep until the last helper leaves.
+    const int spin_count = 64;
+    for (int i = 0; i < spin_count && state->active > 0; ++i)
+        std::this_thread::yield();
+    if (state->active > 0) {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->cond.wait(lock, [&state]() { return state->active == 0; });
+    }
+
+    if (state->exception)
+        std::rethrow_exception(state->exception);
+}
+
+#endif
+
+} // namespace mu
@@ -2,6 +2,16 @@
 
 #include "muConfig.h"
 #include <atomic>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <memory>
+#include <exception>
+#include <iterator>
 #if defined(muEnablePPL)
     #include <ppl.h>
 #elif defined(muEnableTBB)
@@ -10,6 +20,15 @@
 
 namespace mu {
 
+#if !defined(muEnablePPL) && !defined(muEnableTBB)
+// native backend of parallel_for and friends.
+// splits [begin, end) into blocks of granularity elements (0: decided by the number of threads) and calls body(block_begin, block_end)
+// on the workers of task_scheduler::instance() and the calling thread.
+// the caller waits only for blocks it has handed out, never runs unrelated tasks. so nested calls and calls with a lock held are safe.
+// the first exception thrown by body is rethrown after all running blocks are done.
+void parallel_for_impl(int begin, int end, int granularity, const std::function<void(int, int)>& body);
+#endif
+
 template<class Index, class Body>
 inline void parallel_for(Index begin, Index end, const Body& body)
 {
@@ -18,7 +37,10 @@ inline void parallel_for(Index begin, Index end, const Body& body)
 #elif defined(muEnableTBB)
     tbb::parallel_for(begin, end, body);
 #else
-    for (; begin != end; ++begin) { body(begin); }
+    parallel_for_impl(0, (int)(end - begin), 0, [&](int b, int e) {
+        for (int i = b; i < e; ++i)
+            body(begin + (Index)i);
+    });
 #endif
 }
 
@@ -29,10 +51,10 @@ inline void parallel_for(int begin, int end, int granularity, const Body& body)
     int num_elements = end - begin;
     int num_blocks = ceildiv(num_elements, granularity);
     parallel_for(0, num_blocks, [&](int i) {
-        int begin = granularity * i;
-        int end = std::min<int>(granularity * (i + 1), num_elements);
-        for (; begin != end; ++begin) {
-            body(begin);
+        int b = begin + granularity * i;
+        int e = std::min<int>(b + granularity, end);
+        for (; b != e; ++b) {
+            body(b);
         }
     });
 }
@@ -42,21 +64,24 @@ inline void parallel_for_blocked(int begin, int end, int granularity, const Body
     int num_elements = end - begin;
     int num_blocks = ceildiv(num_elements, granularity);
     parallel_for(0, num_blocks, [&](int i) {
-        int begin = granularity * i;
-        int end = std::min<int>(granularity * (i + 1), num_elements);
-        body(begin, end);
+        int b = begin + granularity * i;
+        int e = std::min<int>(b + granularity, end);
+        body(b, e);
     });
 }
 #else
 template<class Body>
-inline void parallel_for(int begin, int end, int /*granularity*/, const Body& body)
+inline void parallel_for(int begin, int end, int granularity, const Body& body)
 {
-    for (; begin != end; ++begin) { body(begin); }
+    parallel_for_impl(begin, end, granularity, [&](int b, int e) {
+        for (; b != e; ++b)
+            body(b);
+    });
 }
 template<class Body>
-inline void parallel_for_blocked(int begin, int end, int /*granularity*/, const Body& body)
+inline void parallel_for_blocked(int begin, int end, int granularity, const Body& body)
 {
-    for (; begin != end; ++begin) { body(begin); }
+    parallel_for_impl(begin, end, granularity, body);
 }
 #endif
 
@@ -68,7 +93,11 @@ inline void parallel_for_each(Iter begin, Iter end, const Body& body)
 #elif defined(muEnableTBB)
     tbb::parallel_for_each(begin, end, body);
 #else
-    for (; begin != end; ++begin) { body(*begin); }
+    parallel_for_impl(0, (int)std::distance(begin, end), 0, [&](int b, int e) {
+        auto it = std::next(begin, b);
+        for (; b != e; ++b, ++it)
+            body(*it);
+    });
 #endif
 }
 
@@ -85,13 +114,14 @@ inline void parallel_invoke(Bodies... bodies) { tbb::parallel_invoke(bodies...);
 
 #else
 
-template <class Body>
-inline void parallel_invoke(const Body& body) { body(); }
-
-template<typename Body, typename... Args>
-void parallel_invoke(const Body& first, Args... args) {
-    first();
-    parallel_invoke(args...);
+template <class... Bodies>
+inline void parallel_invoke(const Bodies&... bodies)
+{
+    std::function<void()> tasks[] = { bodies... };
+    parallel_for_impl(0, (int)sizeof...(Bodies), 1, [&](int b, int e) {
+        for (; b != e; ++b)
+            tasks[b]();
+    });
 }
 
 #endif
@@ -132,5 +162,190 @@ private:
     std::atomic_flag lck = ATOMIC_FLAG_INIT;
 };
 
-} // namespace ms
+
+// lock-free multi-producer single-consumer FIFO queue (intrusive MPSC queue with a stub node).
+// push() can be called from any thread. pop() and clear() must be called from one consumer thread.
+// T must be default constructible and move assignable.
+template<class T>
+class mpsc_queue
+{
+public:
+    mpsc_queue() : m_head(&m_stub), m_tail(&m_stub) {}
+    ~mpsc_queue() { clear(); }
+    mpsc_queue(const mpsc_queue&) = delete;
+    mpsc_queue& operator=(const mpsc_queue&) = delete;
+
+    void push(T&& v)
+    {
+        // count before publishing. the consumer may pop the node before push() returns.
+        ++m_size;
+        push_node(new node(std::move(v)));
+    }
+
+    // return false if the queue is empty (or the last push() has not completed yet)
+    bool pop(T& dst)
+    {
+        node *tail = m_tail;
+        node *next = tail->next.load(std::memory_order_acquire);
+        if (tail == &m_stub) {
+            if (!next)
+                return false;
+            m_tail = tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (!next) {
+            if (tail != m_head.load(std::memory_order_acquire))
+                return false;
+            push_node(&m_stub);
+            next = tail->next.load(std::memory_order_acquire);
+            if (!next)
+                return false;
+        }
+        m_tail = next;
+        dst = std::move(tail->value);
+        delete tail;
+        --m_size;
+        return true;
+    }
+
+    void clear()
+    {
+        T tmp;
+        while (pop(tmp)) {}
+    }
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+private:
+    struct node
+    {
+        std::atomic<node*> next{ nullptr };
+        T value;
+
+        node() {}
+        node(T&& v) : value(std::move(v)) {}
+    };
+
+    void push_node(node *n)
+    {
+        n->next.store(nullptr, std::memory_order_relaxed);
+        node *prev = m_head.exchange(n, std::memory_order_acq_rel);
+        prev->next.store(n, std::memory_order_release);
+    }
+
+    node m_stub;
+    std::atomic<node*> m_head;
+    node *m_tail;
+    std::atomic<size_t> m_size{ 0 };
+};
+
+
+// fixed number of worker threads and a bounded FIFO task queue.
+// push() blocks while the queue is full (backpressure to the producer).
+class thread_pool
+{
+public:
+    using task_t = std::function<void()>;
+
+    // max_queue: 0 means unbounded
+    thread_pool(int num_threads, int max_queue = 0);
+    ~thread_pool(); // completes all queued tasks before return
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    std::future<void> push(const task_t& task);
+    int getNumThreads() const;
+    int getNumQueued();
+
+private:
+    void process();
+
+    std::vector<std::thread> m_threads;
+    std::deque<std::packaged_task<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_cond_push, m_cond_pop;
+    size_t m_max_queue = 0;
+    bool m_stop = false;
+};
+
+
+
+// shared work-stealing task scheduler.
+// each worker has its own deque. it runs its own tasks from the back (LIFO, cache friendly) and steals from the front of others'.
+// tasks pushed from non-worker threads go to a shared queue. use task_group to wait for tasks.
+class task_scheduler
+{
+public:
+    using task_t = std::function<void()>;
+
+    // process wide instance with a worker per hardware thread. never destroyed.
+    static task_scheduler& instance();
+
+    // num_threads: 0 means number of hardware threads
+    task_scheduler(int num_threads = 0);
+    ~task_scheduler(); // completes all queued tasks before return
+    task_scheduler(const task_scheduler&) = delete;
+    task_scheduler& operator=(const task_scheduler&) = delete;
+
+    void push(task_t&& task);
+    // run a queued task on the calling thread. return false if nothing to run.
+    bool run_one();
+    bool is_worker() const; // true if the calling thread is a worker of this scheduler
+    int getNumThreads() const;
+
+private:
+    struct task_queue
+    {
+        spin_mutex mutex;
+        std::deque<task_t> tasks;
+    };
+    bool pop(task_t& dst);
+    void process(int index);
+
+    std::vector<std::thread> m_threads;
+    std::vector<std::unique_ptr<task_queue>> m_queues; // per worker
+    task_queue m_shared_queue;
+    std::atomic<int> m_num_queued{ 0 };
+    std::atomic<int> m_num_sleeping{ 0 };
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    bool m_stop = false;
+};
+
+// set of tasks on a task_scheduler that are waited together.
+// waiting workers run queued tasks instead of just blocking, so it is safe to wait in a task.
+// other threads just block until the tasks are done.
+class task_group
+{
+public:
+    using task_t = task_scheduler::task_t;
+
+    // max_pending: run() blocks while this many tasks are pending (backpressure to the producer). 0 means unbounded
+    task_group(int max_pending = 0, task_scheduler& scheduler = task_scheduler::instance());
+    ~task_group(); // waits all tasks
+    task_group(const task_group&) = delete;
+    task_group& operator=(const task_group&) = delete;
+
+    void run(task_t task);
+    // same as run() but returns the future of the task. exceptions go to it instead of wait().
+    std::future<void> async(task_t task);
+    // rethrows the first exception thrown by tasks
+    void wait();
+    int getNumPending() const;
+
+private:
+    void wait_pending(int n);
+    void finish();
+
+    task_scheduler& m_scheduler;
+    int m_max_pending = 0;
+    std::atomic<int> m_pending{ 0 };
+    int m_num_waiting = 0;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::exception_ptr m_exception;
+};
+
+} // namespace mu
 
@@ -4,6 +4,7 @@
 //   muEnablePPL
 //   muEnableTBB
 //   muEnableISPC
+//   muEnableIntrinsics
 //   muEnableAMP
 //   muEnableSymbol
 
@@ -15,3 +16,7 @@
     #define muEnableSymbol
 #endif
 
+// SSE4.2 / AVX2 kernels (muSIMDIntrinsics.cpp). used when ISPC is not available. chosen by cpu at runtime.
+#if defined(__x86_64__) || defined(_M_X64)
+    #define muEnableIntrinsics
+#endif
@@ -0,0 +1,118 @@
+#include "pch.h"
+#include "muHash.h"
+#include "muRawVector.h"
+#include "muConcurrency.h"
+
+namespace mu {
+
+static const uint64_t Prime64_1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t Prime64_2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t Prime64_3 = 0x165667B19E3779F9ULL;
+static const uint64_t Prime64_4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t Prime64_5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t Rotl64(uint64_t v, int r)
+{
+    return (v << r) | (v >> (64 - r));
+}
+
+static inline uint64_t Read64(const uint8_t *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t Read32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t Round64(uint64_t acc, uint64_t input)
+{
+    acc += input * Prime64_2;
+    acc = Rotl64(acc, 31);
+    acc *= Prime64_1;
+    return acc;
+}
+
+static inline uint64_t MergeRound64(uint64_t acc, uint64_t v)
+{
+    acc ^= Round64(0, v);
+    acc = acc * Prime64_1 + Prime64_4;
+    return acc;
+}
+
+uint64_t Hash64_Generic(const void *src_, size_t size, uint64_t seed)
+{
+    auto *p = (const uint8_t*)src_;
+    auto *end = p + size;
+    uint64_t h;
+
+    if (size >= 32) {
+        // 4 independent lanes. keeps multipliers busy in parallel.
+        uint64_t v1 = seed + Prime64_1 + Prime64_2;
+        uint64_t v2 = seed + Prime64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - Prime64_1;
+        auto *limit = end - 32;
+        do {
+            v1 = Round64(v1, Read64(p)); p += 8;
+            v2 = Round64(v2, Read64(p)); p += 8;
+            v3 = Round64(v3, Read64(p)); p += 8;
+            v4 = Round64(v4, Read64(p)); p += 8;
+        } while (p <= limit);
+
+        h = Rotl64(v1, 1) + Rotl64(v2, 7) + Rotl64(v3, 12) + Rotl64(v4, 18);
+        h = MergeRound64(h, v1);
+        h = MergeRound64(h, v2);
+        h = MergeRound64(h, v3);
+        h = MergeRound64(h, v4);
+    }
+    else {
+        h = seed + Prime64_5;
+    }
+    h += (uint64_t)size;
+
+    for (; p + 8 <= end; p += 8) {
+        h ^= Round64(0, Read64(p));
+        h = Rotl64(h, 27) * Prime64_1 + Prime64_4;
+    }
+    if (p + 4 <= end) {
+        h ^= (uint64_t)Read32(p) * Prime64_1;
+        h = Rotl64(h, 23) * Prime64_2 + Prime64_3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        h ^= (*p) * Prime64_5;
+        h = Rotl64(h, 11) * Prime64_1;
+    }
+
+    h ^= h >> 33;
+    h *= Prime64_2;
+    h ^= h >> 29;
+    h *= Prime64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t Hash64(const void *src, size_t size, uint64_t seed)
+{
+    // not worth to make tasks
+    if (size < HashChunkSize * 4)
+        return Hash64_Generic(src, size, seed);
+
+    int num_chunks = (int)((size + HashChunkSize - 1) / HashChunkSize);
+    RawVector<uint64_t> hashes;
+    hashes.resize_discard(num_chunks);
+    parallel_for(0, num_chunks, [&](int i) {
+        size_t offset = HashChunkSize * i;
+        size_t chunk_size = std::min(HashChunkSize, size - offset);
+        hashes[i] = Hash64_Generic((const char*)src + offset, chunk_size, seed);
+    });
+    return Hash64_Generic(hashes.data(), sizeof(uint64_t) * hashes.size(), seed);
+}
+
+} // namespace mu
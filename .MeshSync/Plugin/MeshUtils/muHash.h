@@ -0,0 +1,21 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+namespace mu {
+
+// 64 bit hash (xxHash64). order sensitive and well distributed unlike SumInt32().
+// inputs larger than HashChunkSize are split into chunks that are hashed in parallel and then hashed again.
+// the result depends only on the input (not on the number of threads).
+uint64_t Hash64(const void *src, size_t size, uint64_t seed = 0);
+uint64_t Hash64_Generic(const void *src, size_t size, uint64_t seed = 0);
+
+static const size_t HashChunkSize = 256 * 1024;
+
+// order sensitive combination of hashes
+inline uint64_t HashCombine(uint64_t h, uint64_t v)
+{
+    return h ^ (v + 0x9E3779B97F4A7C15ULL + (h << 6) + (h >> 2));
+}
+
+} // namespace mu
@@ -0,0 +1,164 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <functional>
+#include "muHash.h"
+
+namespace mu {
+
+template<class T>
+struct hash_of
+{
+    uint64_t operator()(const T& v) const { return (uint64_t)std::hash<T>()(v); }
+};
+template<>
+struct hash_of<std::string>
+{
+    uint64_t operator()(const std::string& v) const { return Hash64(v.data(), v.size()); }
+};
+
+// open addressing hash map with linear probing. all elements are in one array, so lookups don't chase pointers.
+// erase() shifts following elements back instead of leaving tombstones.
+// references to values are invalidated when the table grows or an element is erased.
+// functions that take a hash allow callers to compute it once (e.g. to select a shard and then look up).
+template<class Key, class Value, class Hasher = hash_of<Key>>
+class flat_hash_map
+{
+public:
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    void clear()
+    {
+        m_slots.clear();
+        m_size = 0;
+        m_shift = 64;
+    }
+
+    void reserve(size_t n)
+    {
+        size_t capacity = 8;
+        while (capacity * 3 < n * 4)
+            capacity *= 2;
+        if (capacity > m_slots.size())
+            rehash(capacity);
+    }
+
+    Value* find(const Key& key) { return find(key, Hasher()(key)); }
+    Value* find(const Key& key, uint64_t hash)
+    {
+        if (m_size == 0)
+            return nullptr;
+        size_t mask = m_slots.size() - 1;
+        for (size_t i = home(hash); ; i = (i + 1) & mask) {
+            auto& s = m_slots[i];
+            if (!s.used)
+                return nullptr;
+            if (s.hash == hash && s.key == key)
+                return &s.value;
+        }
+    }
+    const Value* find(const Key& key) const { return const_cast<flat_hash_map*>(this)->find(key); }
+    const Value* find(const Key& key, uint64_t hash) const { return const_cast<flat_hash_map*>(this)->find(key, hash); }
+
+    // insert default constructed value if not exist
+    Value& operator[](const Key& key) { return get(key, Hasher()(key)); }
+    Value& get(const Key& key, uint64_t hash)
+    {
+        if ((m_size + 1) * 4 > m_slots.size() * 3)
+            rehash(m_slots.empty() ? 8 : m_slots.size() * 2);
+
+        size_t mask = m_slots.size() - 1;
+        size_t i = home(hash);
+        for (; m_slots[i].used; i = (i + 1) & mask) {
+            auto& s = m_slots[i];
+            if (s.hash == hash && s.key == key)
+                return s.value;
+        }
+        auto& s = m_slots[i];
+        s.key = key;
+        s.hash = hash;
+        s.used = true;
+        ++m_size;
+        return s.value;
+    }
+
+    bool erase(const Key& key) { return erase(key, Hasher()(key)); }
+    bool erase(const Key& key, uint64_t hash)
+    {
+        if (m_size == 0)
+            return false;
+        size_t mask = m_slots.size() - 1;
+        size_t i = home(hash);
+        for (; ; i = (i + 1) & mask) {
+            auto& s = m_slots[i];
+            if (!s.used)
+                return false;
+            if (s.hash == hash && s.key == key)
+                break;
+        }
+
+        // shift back following elements that can't be reached from their home slot once i is empty
+        for (size_t j = (i + 1) & mask; m_slots[j].used; j = (j + 1) & mask) {
+            size_t k = home(m_slots[j].hash);
+            if (((j - k) & mask) >= ((j - i) & mask)) {
+                m_slots[i] = std::move(m_slots[j]);
+                i = j;
+            }
+        }
+        m_slots[i] = slot();
+        --m_size;
+        return true;
+    }
+
+    // body: [](const Key& key, Value& value) -> void
+    template<class Body>
+    void each(const Body& body)
+    {
+        for (auto& s : m_slots) {
+            if (s.used)
+                body(const_cast<const Key&>(s.key), s.value);
+        }
+    }
+
+private:
+    struct slot
+    {
+        Key key;
+        Value value;
+        uint64_t hash = 0;
+        bool used = false;
+    };
+
+    // fibonacci hashing. spreads sequential keys (e.g. ids with identity hash) over the table.
+    size_t home(uint64_t hash) const
+    {
+        return (size_t)((hash * 0x9E3779B97F4A7C15ULL) >> m_shift);
+    }
+
+    void rehash(size_t capacity)
+    {
+        std::vector<slot> old;
+        old.swap(m_slots);
+        m_slots.resize(capacity);
+        m_shift = 64;
+        for (size_t c = capacity; c > 1; c >>= 1)
+            --m_shift;
+
+        size_t mask = capacity - 1;
+        for (auto& s : old) {
+            if (!s.used)
+                continue;
+            size_t i = home(s.hash);
+            while (m_slots[i].used)
+                i = (i + 1) & mask;
+            m_slots[i] = std::move(s);
+        }
+    }
+
+    std::vector<slot> m_slots;
+    size_t m_size = 0;
+    int m_shift = 64;
+};
+
+} // namespace mu
@@ -19,10 +19,10 @@ void MeshConnectionInfo::clear()
 }
 
 void MeshConnectionInfo::buildConnection(
-    const IArray<int>& indices_, int ngon_, const IArray<float3>& vertices_, bool welding)
+    const IArray<int>& indices_, int ngon_, const IArray<float3>& vertices_, bool welding, float welding_epsilon)
 {
     if (welding) {
-        impl::BuildWeldMap(*this, vertices_);
+        impl::BuildWeldMap(*this, vertices_, welding_epsilon);
 
         impl::IndicesW indices__{ indices_, weld_map };
         impl::CountsC counts_{ ngon_, indices_.size()/ngon_ };
@@ -35,10 +35,10 @@ void MeshConnectionInfo::buildConnection(
 }
 
 void MeshConnectionInfo::buildConnection(
-    const IArray<int>& indices_, const IArray<int>& counts_, const IArray<float3>& vertices_, bool welding)
+    const IArray<int>& indices_, const IArray<int>& counts_, const IArray<float3>& vertices_, bool welding, float welding_epsilon)
 {
     if (welding) {
-        impl::BuildWeldMap(*this, vertices_);
+        impl::BuildWeldMap(*this, vertices_, welding_epsilon);
 
         impl::IndicesW vi{ indices_, weld_map };
         impl::BuildConnection(*this, vi, counts_, vertices_);
@@ -49,6 +49,37 @@ void MeshConnectionInfo::buildConnection(
 }
 
 
+bool MeshConnectionInfo::isBuilt(size_t num_points, size_t num_indices) const
+{
+    return v2f_counts.size() == num_points && v2f_indices.size() == num_indices && weld_map.empty();
+}
+
+void MeshConnectionInfo::ensureConnection(const IArray<int>& indices_, int ngon_, const IArray<float3>& vertices_)
+{
+    if (!isBuilt(vertices_.size(), indices_.size()))
+        buildConnection(indices_, ngon_, vertices_);
+}
+
+void MeshConnectionInfo::ensureConnection(const IArray<int>& indices_, const IArray<int>& counts_, const IArray<float3>& vertices_)
+{
+    if (!isBuilt(vertices_.size(), indices_.size()))
+        buildConnection(indices_, counts_, vertices_);
+}
+
+void MeshConnectionInfo::swap(MeshConnectionInfo& v)
+{
+    v2f_counts.swap(v.v2f_counts);
+    v2f_offsets.swap(v.v2f_offsets);
+    v2f_faces.swap(v.v2f_faces);
+    v2f_indices.swap(v.v2f_indices);
+
+    weld_map.swap(v.weld_map);
+    weld_counts.swap(v.weld_counts);
+    weld_offsets.swap(v.weld_offsets);
+    weld_indices.swap(v.weld_indices);
+}
+
+
 bool OnEdge(const IArray<int>& indices, int ngon, const IArray<float3>& vertices, const MeshConnectionInfo& connection, int vertex_index)
 {
     impl::CountsC counts{ ngon, indices.size() / ngon };
@@ -331,20 +362,95 @@ void MeshRefiner::clear()
     splits.clear();
     submeshes.clear();
     connection.clear();
+
+    filtered_counts.clear();
+    filtered_indices.clear();
+    seams.clear();
+    run_heads.clear();
+    emit_indices.clear();
+}
+
+bool MeshRefiner::isEmitted(int count) const
+{
+    return (count >= 3 && gen_triangles) || (count == 2 && gen_lines) || (count == 1 && gen_points);
 }
 
+// refine() runs in 3 passes:
+//  1. (parallel per vertex) find runs of connected indices whose attributes are identical.
+//     a vertex is emitted once per run, so all comparisons are done here.
+//  2. (sequential) partition faces into splits and assign new vertex indices. integer work only.
+//  3. (parallel per new vertex) copy points and attributes.
+// the result is identical to emitting faces one by one and reusing the vertex emitted by the previous
+// appearance of the same point when all attributes are equal.
 void MeshRefiner::refine()
 {
     buildConnection();
 
+    int num_points = (int)points.size();
     int num_indices = (int)indices.size();
-    new_points.reserve(num_indices);
-    new_indices.reserve(num_indices);
-    for (auto& attr : attributes) { attr->prepare((int)points.size(), (int)indices.size()); }
+    int num_faces_total = (int)counts.size();
 
-    old2new_indices.resize(num_indices, -1);
+    // pass 1
+    const int *conn_counts = connection.v2f_counts.data();
+    const int *conn_offsets = connection.v2f_offsets.data();
+    const int *connected = connection.v2f_indices.data();
+    if (!gen_triangles || !gen_lines || !gen_points) {
+        // drop connections to faces that are not emitted
+        filtered_counts.resize_discard(num_points);
+        filtered_indices.resize_discard(num_indices);
+        parallel_for_blocked(0, num_points, 4096, [&](int begin, int end) {
+            for (int vi = begin; vi < end; ++vi) {
+                int count = connection.v2f_counts[vi];
+                int offset = connection.v2f_offsets[vi];
+                int n = 0;
+                for (int ci = 0; ci < count; ++ci) {
+                    if (isEmitted(counts[connection.v2f_faces[offset + ci]]))
+                        filtered_indices[offset + n++] = connection.v2f_indices[offset + ci];
+                }
+                filtered_counts[vi] = n;
+            }
+        });
+        conn_counts = filtered_counts.data();
+        connected = filtered_indices.data();
+    }
+
+    seams.resize_discard(num_indices);
+    run_heads.resize_discard(num_indices);
+    parallel_for_blocked(0, num_points, 4096, [&](int begin, int end) {
+        // connections of a block of vertices are contiguous
+        int conn_begin = conn_offsets[begin];
+        int conn_end = conn_offsets[end - 1] + connection.v2f_counts[end - 1];
+        memset(seams.data() + conn_begin, 0, conn_end - conn_begin);
+
+        for (auto& attr : attributes)
+            attr->markSeams(conn_counts, conn_offsets, connected, seams.data(), begin, end);
+
+        for (int vi = begin; vi < end; ++vi) {
+            int count = conn_counts[vi];
+            int offset = conn_offsets[vi];
+            int head = 0;
+            for (int ci = 0; ci < count; ++ci) {
+                int ii = connected[offset + ci];
+                if (ci == 0 || seams[offset + ci])
+                    head = ii;
+                run_heads[ii] = head;
+            }
+        }
+    });
+
+    // pass 2
+    // old2new_indices holds the new vertex of each run head. values below offset_vertices belong to previous splits.
+    old2new_indices.resize_discard(num_indices);
+    memset(old2new_indices.data(), -1, old2new_indices.size() * sizeof(int));
+    // sized for the worst case and shrunk at the end
+    emit_indices.resize_discard(num_indices);
+    new_indices.resize_discard(num_indices);
+    new_counts.resize_discard(num_faces_total);
+    int *dst_emit = emit_indices.data();
+    int *dst_indices = new_indices.data();
+    int *dst_counts = new_counts.data();
+    int num_new_vertices = 0;
 
-    int num_faces_total = (int)counts.size();
     int offset_faces = 0;
     int offset_indices = 0;
     int offset_vertices = 0;
@@ -362,8 +468,8 @@ void MeshRefiner::refine()
         split.index_count_tri = num_indices_tri;
         split.index_count_lines = num_indices_lines;
         split.index_count_points = num_indices_points;
-        split.vertex_count = (int)new_points.size() - offset_vertices;
-        split.index_count = (int)new_indices.size() - offset_indices;
+        split.vertex_count = num_new_vertices - offset_vertices;
+        split.index_count = (int)std::distance(new_indices.data(), dst_indices) - offset_indices;
         splits.push_back(split);
 
         offset_faces += split.face_count;
@@ -376,69 +482,58 @@ void MeshRefiner::refine()
         num_indices_points = 0;
     };
 
-    auto compare_all_attributes = [&](int ni, int ii) -> bool {
-        for (auto& attr : attributes)
-            if (!attr->compare(ni, ii)) { return false; }
-        return true;
-    };
-
-    auto find_or_emit_vertex = [&](int vi, int ii) -> int {
-        int offset = connection.v2f_offsets[vi];
-        int connection_count = connection.v2f_counts[vi];
-        for (int ci = 0; ci < connection_count; ++ci) {
-            int& ni = old2new_indices[connection.v2f_indices[offset + ci]];
-            if (ni != -1 && compare_all_attributes(ni, ii)) {
-                return ni;
-            }
-            else {
-                ni = (int)new_points.size();
-                new_points.push_back(points[vi]);
-                new2old_points.push_back(vi);
-                for (auto& attr : attributes) { attr->emit(ii); }
-                return ni;
-            }
-        }
-        return 0;
-    };
-
-    new_counts.reserve(counts.size());
     int offset = 0;
     for (int fi = 0; fi < num_faces_total; ++fi) {
         int count = counts[fi];
-        if ((count >= 3 && gen_triangles) || (count == 2 && gen_lines) || (count == 1 && gen_points))
-        {
-            if (split_unit > 0 && (int)new_points.size() - offset_vertices + count > split_unit) {
+        if (isEmitted(count)) {
+            if (split_unit > 0 && num_new_vertices - offset_vertices + count > split_unit)
                 add_new_split();
 
-                // clear vertex cache
-                memset(old2new_indices.data(), -1, old2new_indices.size() * sizeof(int));
-            }
-
             for (int ci = 0; ci < count; ++ci) {
                 int ii = offset + ci;
-                int vi = indices[ii];
-                new_indices.push_back(find_or_emit_vertex(vi, ii));
+                int& ni = old2new_indices[run_heads[ii]];
+                if (ni < offset_vertices) {
+                    // first appearance of the run in this split
+                    ni = num_new_vertices++;
+                    *(dst_emit++) = ii;
+                }
+                *(dst_indices++) = ni;
             }
             ++num_faces;
-            new_counts.push_back(count);
+            *(dst_counts++) = count;
             if (count >= 3)
                 num_indices_tri += (count - 2) * 3;
             else if (count == 2)
                 num_indices_lines += 2;
             else if (count == 1)
                 num_indices_points += 1;
-
         }
         offset += count;
     }
     add_new_split();
+    emit_indices.resize(num_new_vertices);
+    new_indices.resize(std::distance(new_indices.data(), dst_indices));
+    new_counts.resize(std::distance(new_counts.data(), dst_counts));
+
+    // pass 3
+    new_points.resize_discard(num_new_vertices);
+    new2old_points.resize_discard(num_new_vertices);
+    for (auto& attr : attributes) { attr->prepare(num_new_vertices); }
+
+    parallel_for_blocked(0, num_new_vertices, 8192, [&](int begin, int end) {
+        for (int ni = begin; ni < end; ++ni) {
+            int vi = indices[emit_indices[ni]];
+            new_points[ni] = points[vi];
+            new2old_points[ni] = vi;
+        }
+        for (auto& attr : attributes)
+            attr->emit(emit_indices.data(), begin, end);
+    });
 }
 
 void MeshRefiner::buildConnection()
 {
-    if (connection.v2f_counts.size() != points.size()) {
-        connection.buildConnection(indices, counts, points);
-    }
+    connection.ensureConnection(indices, counts, points);
 }
 
 } // namespace mu
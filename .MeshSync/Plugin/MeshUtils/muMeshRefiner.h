@@ -20,10 +20,20 @@ struct MeshConnectionInfo
     RawVector<int> weld_indices;
 
     void clear();
+    // welding: treat vertices at the same position (or within welding_epsilon if it is > 0) as one
     void buildConnection(
-        const IArray<int>& indices, int ngon, const IArray<float3>& vertices, bool welding = false);
+        const IArray<int>& indices, int ngon, const IArray<float3>& vertices, bool welding = false, float welding_epsilon = 0.0f);
     void buildConnection(
-        const IArray<int>& indices, const IArray<int>& counts, const IArray<float3>& vertices, bool welding = false);
+        const IArray<int>& indices, const IArray<int>& counts, const IArray<float3>& vertices, bool welding = false, float welding_epsilon = 0.0f);
+
+    // connection is often needed by several steps of processing one mesh (normal generation, refinement, etc).
+    // ensureConnection() builds it only if it is not built (without welding) for a mesh of the same size yet,
+    // so one instance can be passed around and built once. topology changes that keep the number of points and
+    // indices can't be detected. call clear() when the topology changes.
+    bool isBuilt(size_t num_points, size_t num_indices) const;
+    void ensureConnection(const IArray<int>& indices, int ngon, const IArray<float3>& vertices);
+    void ensureConnection(const IArray<int>& indices, const IArray<int>& counts, const IArray<float3>& vertices);
+    void swap(MeshConnectionInfo& v);
 
     // Body: [](int face_index, int index_index) -> void
     template<class Body>
@@ -115,7 +125,7 @@ struct MeshRefiner
     RawVector<float3> new_points;
     RawVector<Split> splits;
     RawVector<Submesh> submeshes;
-    MeshConnectionInfo connection;
+    MeshConnectionInfo connection; // built by refine() if not built yet. can be set (swapped) in advance to share it
 
     // attributes
     template<class T>
@@ -150,14 +160,38 @@ struct MeshRefiner
 
 private:
     void setupSubmeshes();
+    bool isEmitted(int count) const;
+
+    // flags seams[i] when the value of connected[i] differs from the previous connection of the same vertex.
+    // fetch: [](int index_index) -> T. inlined into the loop, so there is no virtual call per element.
+    template<class Fetch>
+    static void MarkSeams(const int *conn_counts, const int *conn_offsets, const int *connected, uint8_t *seams,
+        int vertex_begin, int vertex_end, const Fetch& fetch)
+    {
+        for (int vi = vertex_begin; vi < vertex_end; ++vi) {
+            int count = conn_counts[vi];
+            if (count == 0)
+                continue;
+            int offset = conn_offsets[vi];
+            auto prev = fetch(connected[offset]);
+            for (int ci = 1; ci < count; ++ci) {
+                auto cur = fetch(connected[offset + ci]);
+                if (!(cur == prev))
+                    seams[offset + ci] = 1;
+                prev = cur;
+            }
+        }
+    }
 
+    // virtual calls are made per block of vertices, not per element
     class IAttribute
     {
     public:
         virtual ~IAttribute() {}
-        virtual void prepare(int vertex_count, int index_count) = 0;
-        virtual bool compare(int vertex_index, int index_index) = 0;
-        virtual void emit(int index_index) = 0;
+        virtual void prepare(int new_vertex_count) = 0;
+        virtual void markSeams(const int *conn_counts, const int *conn_offsets, const int *connected, uint8_t *seams,
+            int vertex_begin, int vertex_end) = 0;
+        virtual void emit(const int *src_indices, int new_begin, int new_end) = 0;
         virtual void clear() = 0;
     };
 
@@ -165,21 +199,30 @@ private:
     class IndexedAttribute : public IAttribute
     {
     public:
-        void prepare(int /*vertex_count*/, int /*index_count*/) override
+        void prepare(int new_vertex_count) override
         {
-            clear();
+            new_values->resize_discard(new_vertex_count);
+            new2old->resize_discard(new_vertex_count);
         }
 
-        bool compare(int ni, int ii) override
+        void markSeams(const int *conn_counts, const int *conn_offsets, const int *connected, uint8_t *seams,
+            int vertex_begin, int vertex_end) override
         {
-            return (*new_values)[ni] == values[indices[ii]];
+            const T *v = values.data();
+            const int *idx = indices.data();
+            MarkSeams(conn_counts, conn_offsets, connected, seams, vertex_begin, vertex_end,
+                [v, idx](int ii) { return v[idx[ii]]; });
         }
 
-        void emit(int ii) override
+        void emit(const int *src_indices, int new_begin, int new_end) override
         {
-            int i = indices[ii];
-            new_values->push_back(values[i]);
-            new2old->push_back(i);
+            T *dst_values = new_values->data();
+            int *dst_new2old = new2old->data();
+            for (int ni = new_begin; ni < new_end; ++ni) {
+                int i = indices[src_indices[ni]];
+                dst_values[ni] = values[i];
+                dst_new2old[ni] = i;
+            }
         }
 
         void clear() override
@@ -198,20 +241,29 @@ private:
     class ExpandedAttribute : public IAttribute
     {
     public:
-        void prepare(int /*vertex_count*/, int /*index_count*/) override
+        void prepare(int new_vertex_count) override
         {
-            clear();
+            new_values->resize_discard(new_vertex_count);
+            new2old->resize_discard(new_vertex_count);
         }
 
-        bool compare(int ni, int ii) override
+        void markSeams(const int *conn_counts, const int *conn_offsets, const int *connected, uint8_t *seams,
+            int vertex_begin, int vertex_end) override
         {
-            return (*new_values)[ni] == values[ii];
+            const T *v = values.data();
+            MarkSeams(conn_counts, conn_offsets, connected, seams, vertex_begin, vertex_end,
+                [v](int ii) { return v[ii]; });
         }
 
-        void emit(int ii) override
+        void emit(const int *src_indices, int new_begin, int new_end) override
         {
-            new_values->push_back(values[ii]);
-            new2old->push_back(ii);
+            T *dst_values = new_values->data();
+            int *dst_new2old = new2old->data();
+            for (int ni = new_begin; ni < new_end; ++ni) {
+                int ii = src_indices[ni];
+                dst_values[ni] = values[ii];
+                dst_new2old[ni] = ii;
+            }
         }
 
         void clear() override
@@ -242,6 +294,13 @@ private:
     RawVector<IAttribute*> attributes;
     RawVector<char> buf_attributes;
     static const int max_attributes = 8; // you can increase this if needed
+
+    // work buffers of refine()
+    RawVector<int> filtered_counts;  // connections to emitted faces only. used when some topologies are not generated
+    RawVector<int> filtered_indices;
+    RawVector<uint8_t> seams;        // per connection. 1 if attributes differ from the previous connection of the vertex
+    RawVector<int> run_heads;        // per index. the first index of the run of identical attributes it belongs to
+    RawVector<int> emit_indices;     // per new vertex. the index it is emitted from
 };
 
 } // namespace mu
@@ -2,6 +2,9 @@
 #include "muMath.h"
 #include "muSIMD.h"
 #include "muRawVector.h"
+#if defined(muEnableIntrinsics) && defined(_MSC_VER)
+    #include <intrin.h>
+#endif
 
 namespace mu {
 
@@ -266,35 +269,85 @@ void GenerateTangentsTriangleSoA_ISPC(float4 *dst,
 #endif // muEnableISPC
 
 
-#ifdef muEnableISPC
+#ifdef muEnableIntrinsics
+static SIMDLevel DetectSIMDLevel()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    int max_id = info[0];
+    __cpuid(info, 1);
+    bool sse42 = (info[2] & (1 << 20)) != 0;
+    // avx registers must be enabled by the OS too
+    bool avx = (info[2] & (1 << 28)) != 0 && (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+    bool avx2 = false;
+    if (avx && max_id >= 7) {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+#else
+    __builtin_cpu_init();
+    bool sse42 = __builtin_cpu_supports("sse4.2") != 0;
+    bool avx2 = __builtin_cpu_supports("avx2") != 0;
+#endif
+    if (sse42 && avx2)
+        return SIMDLevel::AVX2;
+    else if (sse42)
+        return SIMDLevel::SSE42;
+    else
+        return SIMDLevel::Generic;
+}
+#endif
+
+SIMDLevel GetSIMDLevel()
+{
+#ifdef muEnableIntrinsics
+    static const SIMDLevel s_level = DetectSIMDLevel();
+    return s_level;
+#else
+    return SIMDLevel::Generic;
+#endif
+}
+
+
+// ForwardSSE42 / ForwardAVX2 are for kernels that have intrinsics variants.
+#if defined(muEnableISPC)
     #define Forward(Name, ...) Name##_ISPC(__VA_ARGS__)
+    #define ForwardSSE42(Name, ...) Name##_ISPC(__VA_ARGS__)
+    #define ForwardAVX2(Name, ...) Name##_ISPC(__VA_ARGS__)
+#elif defined(muEnableIntrinsics)
+    #define Forward(Name, ...) Name##_Generic(__VA_ARGS__)
+    #define ForwardSSE42(Name, ...) (GetSIMDLevel() >= SIMDLevel::SSE42 ? Name##_SSE42(__VA_ARGS__) : Name##_Generic(__VA_ARGS__))
+    #define ForwardAVX2(Name, ...) (GetSIMDLevel() >= SIMDLevel::AVX2 ? Name##_AVX2(__VA_ARGS__) : ForwardSSE42(Name, __VA_ARGS__))
 #else
     #define Forward(Name, ...) Name##_Generic(__VA_ARGS__)
+    #define ForwardSSE42(Name, ...) Name##_Generic(__VA_ARGS__)
+    #define ForwardAVX2(Name, ...) Name##_Generic(__VA_ARGS__)
 #endif
 
 #if defined(muSIMD_SumInt32) || !defined(muEnableISPC)
 uint64_t SumInt32(const void *src, size_t num)
 {
-    return Forward(SumInt32, (uint32_t*)src, num / sizeof(uint32_t));
+    return ForwardAVX2(SumInt32, (uint32_t*)src, num / sizeof(uint32_t));
 }
 #endif
 
 #if defined(muSIMD_Float_Half_Conversion) || !defined(muEnableISPC)
-void F32ToF16(half *dst, const float *src, size_t num) { Forward(F32ToF16, dst, src, num); }
-void F16ToF32(float *dst, const half *src, size_t num) { Forward(F16ToF32, dst, src, num); }
+void F32ToF16(half *dst, const float *src, size_t num) { ForwardSSE42(F32ToF16, dst, src, num); }
+void F16ToF32(float *dst, const half *src, size_t num) { ForwardSSE42(F16ToF32, dst, src, num); }
 #endif
 
 #if defined(muSIMD_Float_Norm_Conversion) || !defined(muEnableISPC)
-void F32ToS8(snorm8 *dst, const float *src, size_t num) { Forward(F32ToS8, dst, src, num); }
-void S8ToF32(float *dst, const snorm8 *src, size_t num) { Forward(S8ToF32, dst, src, num); }
-void F32ToU8(unorm8 *dst, const float *src, size_t num) { Forward(F32ToU8, dst, src, num); }
-void U8ToF32(float *dst, const unorm8 *src, size_t num) { Forward(U8ToF32, dst, src, num); }
-void F32ToU8N(unorm8n *dst, const float *src, size_t num) { Forward(F32ToU8N, dst, src, num); }
-void U8NToF32(float *dst, const unorm8n *src, size_t num) { Forward(U8NToF32, dst, src, num); }
-void F32ToS16(snorm16 *dst, const float *src, size_t num) { Forward(F32ToS16, dst, src, num); }
-void S16ToF32(float *dst, const snorm16 *src, size_t num) { Forward(S16ToF32, dst, src, num); }
-void F32ToU16(unorm16 *dst, const float *src, size_t num) { Forward(F32ToU16, dst, src, num); }
-void U16ToF32(float *dst, const unorm16 *src, size_t num) { Forward(U16ToF32, dst, src, num); }
+void F32ToS8(snorm8 *dst, const float *src, size_t num) { ForwardSSE42(F32ToS8, dst, src, num); }
+void S8ToF32(float *dst, const snorm8 *src, size_t num) { ForwardSSE42(S8ToF32, dst, src, num); }
+void F32ToU8(unorm8 *dst, const float *src, size_t num) { ForwardSSE42(F32ToU8, dst, src, num); }
+void U8ToF32(float *dst, const unorm8 *src, size_t num) { ForwardSSE42(U8ToF32, dst, src, num); }
+void F32ToU8N(unorm8n *dst, const float *src, size_t num) { ForwardSSE42(F32ToU8N, dst, src, num); }
+void U8NToF32(float *dst, const unorm8n *src, size_t num) { ForwardSSE42(U8NToF32, dst, src, num); }
+void F32ToS16(snorm16 *dst, const float *src, size_t num) { ForwardSSE42(F32ToS16, dst, src, num); }
+void S16ToF32(float *dst, const snorm16 *src, size_t num) { ForwardSSE42(S16ToF32, dst, src, num); }
+void F32ToU16(unorm16 *dst, const float *src, size_t num) { ForwardSSE42(F32ToU16, dst, src, num); }
+void U16ToF32(float *dst, const unorm16 *src, size_t num) { ForwardSSE42(U16ToF32, dst, src, num); }
 void F32ToS24(snorm24 *dst, const float *src, size_t num) { Forward(F32ToS24, dst, src, num); }
 void S24ToF32(float *dst, const snorm24 *src, size_t num) { Forward(S24ToF32, dst, src, num); }
 void F32ToS32(snorm32 *dst, const float *src, size_t num) { Forward(F32ToS32, dst, src, num); }
@@ -305,40 +358,40 @@ void S32ToF32(float *dst, const snorm32 *src, size_t num) { Forward(S32ToF32, ds
 #if defined(muSIMD_InvertX3) || !defined(muEnableISPC)
 void InvertX(float3 *dst, size_t num)
 {
-    Forward(InvertX, dst, num);
+    ForwardSSE42(InvertX, dst, num);
 }
 #endif
 #if defined(muSIMD_InvertX4) || !defined(muEnableISPC)
 void InvertX(float4 *dst, size_t num)
 {
-    Forward(InvertX, dst, num);
+    ForwardSSE42(InvertX, dst, num);
 }
 #endif
 
 #if defined(muSIMD_Scale) || !defined(muEnableISPC)
 void Scale(float *dst, float s, size_t num)
 {
-    Forward(Scale, dst, s, num);
+    ForwardAVX2(Scale, dst, s, num);
 }
 #endif
 #if defined(muSIMD_Scale) || !defined(muEnableISPC)
 void Scale(float3 *dst, float s, size_t num)
 {
-    Forward(Scale, dst, s, num);
+    ForwardAVX2(Scale, dst, s, num);
 }
 #endif
 
 #if defined(muSIMD_Normalize) || !defined(muEnableISPC)
 void Normalize(float3 *dst, size_t num)
 {
-    Forward(Normalize, dst, num);
+    ForwardSSE42(Normalize, dst, num);
 }
 #endif
 
 #if defined(muSIMD_Lerp) || !defined(muEnableISPC)
 void Lerp(float *dst, const float *src1, const float *src2, size_t num, float w)
 {
-    Forward(Lerp, dst, src1, src2, num, w);
+    ForwardAVX2(Lerp, dst, src1, src2, num, w);
 }
 void Lerp(float2 *dst, const float2 *src1, const float2 *src2, size_t num, float w)
 {
@@ -355,17 +408,17 @@ void Lerp(float4 *dst, const float4 *src1, const float4 *src2, size_t num, float
 #endif
 
 #if defined(muSIMD_MinMax) || !defined(muEnableISPC)
-void MinMax(const int *p, size_t num, int& dst_min, int& dst_max) { Forward(MinMax, p, num, dst_min, dst_max); }
-void MinMax(const float *p, size_t num, float& dst_min, float& dst_max) { Forward(MinMax, p, num, dst_min, dst_max); }
-void MinMax(const float2 *p, size_t num, float2& dst_min, float2& dst_max) { Forward(MinMax, p, num, dst_min, dst_max); }
-void MinMax(const float3 *p, size_t num, float3& dst_min, float3& dst_max) { Forward(MinMax, p, num, dst_min, dst_max); }
-void MinMax(const float4 *p, size_t num, float4& dst_min, float4& dst_max) { Forward(MinMax, p, num, dst_min, dst_max); }
+void MinMax(const int *p, size_t num, int& dst_min, int& dst_max) { ForwardAVX2(MinMax, p, num, dst_min, dst_max); }
+void MinMax(const float *p, size_t num, float& dst_min, float& dst_max) { ForwardAVX2(MinMax, p, num, dst_min, dst_max); }
+void MinMax(const float2 *p, size_t num, float2& dst_min, float2& dst_max) { ForwardSSE42(MinMax, p, num, dst_min, dst_max); }
+void MinMax(const float3 *p, size_t num, float3& dst_min, float3& dst_max) { ForwardSSE42(MinMax, p, num, dst_min, dst_max); }
+void MinMax(const float4 *p, size_t num, float4& dst_min, float4& dst_max) { ForwardSSE42(MinMax, p, num, dst_min, dst_max); }
 #endif
 
 #if defined(muSIMD_NearEqual) || !defined(muEnableISPC)
 bool NearEqual(const float *src1, const float *src2, size_t num, float eps)
 {
-    return Forward(NearEqual, src1, src2, num, eps);
+    return ForwardAVX2(NearEqual, src1, src2, num, eps);
 }
 bool NearEqual(const float2 *src1, const float2 *src2, size_t num, float eps)
 {
@@ -384,26 +437,26 @@ bool NearEqual(const float4 *src1, const float4 *src2, size_t num, float eps)
 #if defined(muSIMD_MulPoints3) || !defined(muEnableISPC)
 void MulPoints(const float4x4& m, const float3 src[], float3 dst[], size_t num_data)
 {
-    Forward(MulPoints, m, src, dst, num_data);
+    ForwardSSE42(MulPoints, m, src, dst, num_data);
 }
 #endif
 #if defined(muSIMD_MulVectors3) || !defined(muEnableISPC)
 void MulVectors(const float4x4& m, const float3 src[], float3 dst[], size_t num_data)
 {
-    Forward(MulVectors, m, src, dst, num_data);
+    ForwardSSE42(MulVectors, m, src, dst, num_data);
 }
 #endif
 
 #if defined(muSIMD_RayTrianglesIntersectionIndexed) || !defined(muEnableISPC)
 int RayTrianglesIntersectionIndexed(float3 pos, float3 dir, const float3 *vertices, const int *indices, int num_triangles, int& tindex, float& result)
 {
-    return Forward(RayTrianglesIntersectionIndexed, pos, dir, vertices, indices, num_triangles, tindex, result);
+    return ForwardAVX2(RayTrianglesIntersectionIndexed, pos, dir, vertices, indices, num_triangles, tindex, result);
 }
 #endif
 #if defined(muSIMD_RayTrianglesIntersectionFlattened) || !defined(muEnableISPC)
 int RayTrianglesIntersectionFlattened(float3 pos, float3 dir, const float3 *vertices, int num_triangles, int& tindex, float& result)
 {
-    return Forward(RayTrianglesIntersectionFlattened, pos, dir, vertices, num_triangles, tindex, result);
+    return ForwardAVX2(RayTrianglesIntersectionFlattened, pos, dir, vertices, num_triangles, tindex, result);
 }
 #endif
 #if defined(muSIMD_RayTrianglesIntersectionSoA) || !defined(muEnableISPC)
@@ -413,7 +466,7 @@ int RayTrianglesIntersectionSoA(float3 pos, float3 dir,
     const float *v3x, const float *v3y, const float *v3z,
     int num_triangles, int& tindex, float& result)
 {
-    return Forward(RayTrianglesIntersectionSoA, pos, dir, v1x, v1y, v1z, v2x, v2y, v2z, v3x, v3y, v3z, num_triangles, tindex, result);
+    return ForwardAVX2(RayTrianglesIntersectionSoA, pos, dir, v1x, v1y, v1z, v2x, v2y, v2z, v3x, v3y, v3z, num_triangles, tindex, result);
 }
 #endif
 
@@ -440,7 +493,7 @@ bool PolyInside(const float px[], const float py[], int ngon, const float2 minp,
 void GenerateNormalsTriangleIndexed(float3 *dst,
     const float3 *vertices, const int *indices, int num_triangles, int num_vertices)
 {
-    return Forward(GenerateNormalsTriangleIndexed, dst, vertices, indices, num_triangles, num_vertices);
+    return ForwardSSE42(GenerateNormalsTriangleIndexed, dst, vertices, indices, num_triangles, num_vertices);
 }
 #endif
 #if defined(muSIMD_GenerateNormalsTriangleFlattened) || !defined(muEnableISPC)
@@ -448,7 +501,7 @@ void GenerateNormalsTriangleFlattened(float3 *dst,
     const float3 *vertices, const int *indices,
     int num_triangles, int num_vertices)
 {
-    return Forward(GenerateNormalsTriangleFlattened, dst, vertices, indices, num_triangles, num_vertices);
+    return ForwardSSE42(GenerateNormalsTriangleFlattened, dst, vertices, indices, num_triangles, num_vertices);
 }
 #endif
 #if defined(muSIMD_GenerateNormalsTriangleSoA) || !defined(muEnableISPC)
@@ -458,7 +511,7 @@ void GenerateNormalsTriangleSoA(float3 *dst,
     const float *v3x, const float *v3y, const float *v3z,
     const int *indices, int num_triangles, int num_vertices)
 {
-    return Forward(GenerateNormalsTriangleSoA, dst,
+    return ForwardSSE42(GenerateNormalsTriangleSoA, dst,
         v1x, v1y, v1z, v2x, v2y, v2z, v3x, v3y, v3z,
         indices, num_triangles, num_vertices);
 }
@@ -500,4 +553,6 @@ void GenerateTangentsTriangleSoA(float4 *dst,
 #endif
 
 #undef Forward
+#undef ForwardSSE42
+#undef ForwardAVX2
 } // namespace mu
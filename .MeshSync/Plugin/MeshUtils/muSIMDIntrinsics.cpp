@@ -0,0 +1,1002 @@
+#include "pch.h"
+#include "muMath.h"
+#include "muSIMD.h"
+
+#ifdef muEnableIntrinsics
+#include <climits>
+#include <functional>
+#include <immintrin.h>
+
+// functions in this file are compiled for SSE4.2 / AVX2 regardless of the compiler's default target.
+// muSIMD.cpp calls them only if GetSIMDLevel() reports the cpu supports the instruction set.
+// results are bit-identical to the _Generic variants (same operations in the same order, no FMA).
+#ifdef _MSC_VER
+    #define muTargetSSE42
+    #define muTargetAVX2
+#else
+    #define muTargetSSE42 __attribute__((target("sse4.2")))
+    #define muTargetAVX2 __attribute__((target("avx2")))
+#endif
+
+namespace mu {
+
+// ------------------------------------------------------------
+// SSE4.2
+// ------------------------------------------------------------
+
+muTargetSSE42 uint64_t SumInt32_SSE42(const uint32_t *src, size_t num)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+    size_t n = num & ~(size_t)3;
+    for (size_t i = 0; i < n; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(v, zero));
+        acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(v, zero));
+    }
+    uint64_t tmp[2];
+    _mm_storeu_si128((__m128i*)tmp, acc);
+    uint64_t ret = tmp[0] + tmp[1];
+    for (size_t i = n; i < num; ++i)
+        ret += src[i];
+    return ret;
+}
+
+
+// same bit operations as half::half(float) and half::operator float()
+muTargetSSE42 static inline __m128i F32ToF16Bits(__m128 src)
+{
+    __m128i n = _mm_castps_si128(src);
+    __m128i sign_bit = _mm_and_si128(_mm_srli_epi32(n, 16), _mm_set1_epi32(0x8000));
+    __m128i exponent = _mm_max_epi32(_mm_sub_epi32(_mm_srli_epi32(n, 23), _mm_set1_epi32(127 - 15)), _mm_setzero_si128());
+    exponent = _mm_slli_epi32(_mm_and_si128(exponent, _mm_set1_epi32(0x1f)), 10);
+    __m128i mantissa = _mm_and_si128(_mm_srli_epi32(n, 23 - 10), _mm_set1_epi32(0x3ff));
+    return _mm_or_si128(_mm_or_si128(sign_bit, exponent), mantissa);
+}
+muTargetSSE42 static inline __m128 F16BitsToF32(__m128i h)
+{
+    __m128i sign_bit = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x8000)), 16);
+    __m128i exponent = _mm_add_epi32(_mm_and_si128(_mm_srli_epi32(h, 10), _mm_set1_epi32(0x1f)), _mm_set1_epi32(127 - 15));
+    exponent = _mm_slli_epi32(_mm_and_si128(exponent, _mm_set1_epi32(0xff)), 23);
+    __m128i mantissa = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x3ff)), 23 - 10);
+    return _mm_castsi128_ps(_mm_or_si128(_mm_or_si128(sign_bit, exponent), mantissa));
+}
+
+muTargetSSE42 void F32ToF16_SSE42(half *dst, const float *src, size_t num)
+{
+    size_t n = num & ~(size_t)7;
+    for (size_t i = 0; i < n; i += 8) {
+        __m128i a = F32ToF16Bits(_mm_loadu_ps(src + i));
+        __m128i b = F32ToF16Bits(_mm_loadu_ps(src + i + 4));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi32(a, b));
+    }
+    for (size_t i = n; i < num; ++i)
+        dst[i] = src[i];
+}
+muTargetSSE42 void F16ToF32_SSE42(float *dst, const half *src, size_t num)
+{
+    size_t n = num & ~(size_t)7;
+    for (size_t i = 0; i < n; i += 8) {
+        __m128i h = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_ps(dst + i, F16BitsToF32(_mm_cvtepu16_epi32(h)));
+        _mm_storeu_ps(dst + i + 4, F16BitsToF32(_mm_cvtepu16_epi32(_mm_srli_si128(h, 8))));
+    }
+    for (size_t i = n; i < num; ++i)
+        dst[i] = src[i];
+}
+
+
+// float -> norm. truncates toward zero as the constructors of norm types do.
+muTargetSSE42 static inline __m128i ToNorm11(const float *src, float c)
+{
+    __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src), _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+    return _mm_cvttps_epi32(_mm_mul_ps(v, _mm_set1_ps(c)));
+}
+muTargetSSE42 static inline __m128i ToNorm01(const float *src, float c)
+{
+    __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src), _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    return _mm_cvttps_epi32(_mm_mul_ps(v, _mm_set1_ps(c)));
+}
+muTargetSSE42 static inline __m128i ToNorm11U(const float *src, float c)
+{
+    __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src), _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+    v = _mm_add_ps(_mm_mul_ps(v, _mm_set1_ps(0.5f)), _mm_set1_ps(0.5f));
+    return _mm_cvttps_epi32(_mm_mul_ps(v, _mm_set1_ps(c)));
+}
+
+muTargetSSE42 void F32ToS8_SSE42(snorm8 *dst, const float *src, size_t num)
+{
+    size_t n = num & ~(size_t)15;
+    for (size_t i = 0; i < n; i += 16) {
+        auto *s = src + i;
+        __m128i a = _mm_packs_epi32(ToNorm11(s, snorm8::C), ToNorm11(s + 4, snorm8::C));
+        __m128i b = _mm_packs_epi32(ToNorm11(s + 8, snorm8::C), ToNorm11(s + 12, snorm8::C));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi16(a, b));
+    }
+    for (size_t i = n; i < num; ++i)
+        dst[i] = src[i];
+}
+muTargetSSE42 void S8ToF32_SSE42(float *dst, const snorm8 *src, size_t num)
+{
+    const __m128 r = _mm_set1_ps(snorm8::R);
+    size_t n = num & ~(size_t)15;
+    for (size_t i = 0; i < n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        for (int j = 0; j < 4; ++j) {
+            _mm_storeu_ps(dst + i + j * 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepi8_epi32(v)), r));
+            v = _mm_srli_si128(v, 4);
+        }
+    }
+    for (size_t i = n; i < num; ++i)
+        dst[i] = src[i];
+}
+
+muTargetSSE42 void F32ToU8_SSE42(unorm8 *dst, const float *src, size_t num)
+{
+    size_t n = num & ~(size_t)15;
+    for (size_t i = 0; i < n; i += 16) {
+        auto *s = src + i;
+        __m128i a = _mm_packs_epi32(ToNorm01(s, unorm8::C), ToNorm01(s + 4, unorm8::C));
+        __m128i b = _mm_packs_epi32(ToNorm01(s + 8, unorm8::C), ToNorm01(s + 12, unorm8::C));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(a, b));
+    }
+    for (size_t i = n; i < num; ++i)
+        dst[i] = src[i];
+}
+muTargetSSE42 void U8ToF32_SSE42(float *dst, const unorm8 *src, size_t num)
+{
+    const __m128 r = _mm_set1_ps(unorm8::R);
+    size_t n = num & ~(size_t)15;
+    for (size_t i = 0; i < n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        for (int j = 0; j < 4; ++j) {
+            _mm_storeu_ps(dst + i + j * 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(v)), r));
+            v = _mm_srli_si128(v, 4);
+        }
+    }
+    for (size_t i = n; i < num; ++i)
+        dst[i] = src[i];
+}
+
+muTargetSSE42 void F32ToU8N_SSE42(unorm8n *dst, const float *src, size_t num)
+{
+    size_t n = num & ~(size_t)15;
+    for (size_t i = 0; i < n; i += 16) {
+        auto *s = src + i;
+        __m128i a = _mm_packs_epi32(ToNorm11U(s, unorm8n::C), ToNorm11U(s + 4, unorm8n::C));
+        __m128i b = _mm_packs_epi32(ToNorm11U(s + 8, unorm8n::C), ToNorm11U(s + 12, unorm8n::C));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(a, b));
+    }
+    for (size_t i = n; i < num; ++i)
+        dst[i] = src[i];
+}
+muTargetSSE42 void U8NToF32_SSE42(float *dst, const unorm8n *src, size_t num)
+{
+    const __m128 r = _mm_set1_ps(unorm8n::R);
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    size_t n = num & ~(size_t)15;
+    for (size_t i = 0; i < n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        for (int j = 0; j < 4; ++j) {
+            __m128 f = _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(v)), r);
+            _mm_storeu_ps(dst + i + j * 4, _mm_sub_ps(_mm_mul_ps(f, two), one));
+            v = _mm_srli_si128(v, 4);
+        }
+    }
+    for (size_t i = n; i < num; ++i)
+        dst[i] = src[i];
+}
+
+muTargetSSE42 void F32ToS16_SSE42(snorm16 *dst, const float *src, size_t num)
+{
+    size_t n = num & ~(size_t)7;
+    for (size_t i = 0; i < n; i += 8) {
+        __m128i v = _mm_packs_epi32(ToNorm11(src + i, snorm16::C), ToNorm11(src + i + 4, snorm16::C));
+        _mm_storeu_si128((__m128i*)(dst + i), v);
+    }
+    for (size_t i = n; i < num; ++i)
+        dst[i] = src[i];
+}
+muTargetSSE42 void S16ToF32_SSE42(float *dst, const snorm16 *src, size_t num)
+{
+    const __m128 r = _mm_set1_ps(snorm16::R);
+    size_t n = num & ~(size_t)7;
+    for (size_t i = 0; i < n; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepi16_epi32(v)), r));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepi16_epi32(_mm_srli_si128(v, 8))), r));
+    }
+    for (size_t i = n; i < num; ++i)
+        dst[i] = src[i];
+}
+
+muTargetSSE42 void F32ToU16_SSE42(unorm16 *dst, const float *src, size_t num)
+{
+    size_t n = num & ~(size_t)7;
+    for (size_t i = 0; i < n; i += 8) {
+        __m128i v = _mm_packus_epi32(ToNorm01(src + i, unorm16::C), ToNorm01(src + i + 4, unorm16::C));
+        _mm_storeu_si128((__m128i*)(dst + i), v);
+    }
+    for (size_t i = n; i < num; ++i)
+        dst[i] = src[i];
+}
+muTargetSSE42 void U16ToF32_SSE42(float *dst, const unorm16 *src, size_t num)
+{
+    const __m128 r = _mm_set1_ps(unorm16::R);
+    size_t n = num & ~(size_t)7;
+    for (size_t i = 0; i < n; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu16_epi32(v)), r));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu16_epi32(_mm_srli_si128(v, 8))), r));
+    }
+    for (size_t i = n; i < num; ++i)
+        dst[i] = src[i];
+}
+
+
+// float3 arrays are processed 4 elements (3 registers) at a time.
+// x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3 <-> x0-3 | y0-3 | z0-3
+muTargetSSE42 static inline void LoadSoA(const float3 *src, __m128& x, __m128& y, __m128& z)
+{
+    auto *s = (const float*)src;
+    __m128 a = _mm_loadu_ps(s);
+    __m128 b = _mm_loadu_ps(s + 4);
+    __m128 c = _mm_loadu_ps(s + 8);
+    __m128 t0 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 1, 3, 2)); // x2 y2 x3 y3
+    __m128 t1 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 0, 2, 1)); // y0 z0 y1 z1
+    x = _mm_shuffle_ps(a, t0, _MM_SHUFFLE(2, 0, 3, 0));
+    y = _mm_shuffle_ps(t1, t0, _MM_SHUFFLE(3, 1, 2, 0));
+    z = _mm_shuffle_ps(t1, c, _MM_SHUFFLE(3, 0, 3, 1));
+}
+muTargetSSE42 static inline void StoreSoA(float3 *dst, __m128 x, __m128 y, __m128 z)
+{
+    auto *d = (float*)dst;
+    __m128 xy01 = _mm_unpacklo_ps(x, y); // x0 y0 x1 y1
+    __m128 xy23 = _mm_unpackhi_ps(x, y); // x2 y2 x3 y3
+    __m128 zx = _mm_shuffle_ps(z, x, _MM_SHUFFLE(1, 1, 0, 0)); // z0 z0 x1 x1
+    __m128 yz = _mm_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1)); // y1 y1 z1 z1
+    __m128 zx2 = _mm_shuffle_ps(z, xy23, _MM_SHUFFLE(2, 2, 2, 2)); // z2 z2 x3 x3
+    __m128 yz3 = _mm_shuffle_ps(xy23, z, _MM_SHUFFLE(3, 3, 3, 3)); // y3 y3 z3 z3
+    _mm_storeu_ps(d, _mm_shuffle_ps(xy01, zx, _MM_SHUFFLE(2, 0, 1, 0)));
+    _mm_storeu_ps(d + 4, _mm_shuffle_ps(yz, xy23, _MM_SHUFFLE(1, 0, 2, 0)));
+    _mm_storeu_ps(d + 8, _mm_shuffle_ps(zx2, yz3, _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+muTargetSSE42 void InvertX_SSE42(float3 *dst, size_t num)
+{
+    // 4 elements are 3 registers. x is at lane 0 & 3, 2 and 1 of each register.
+    const __m128 m0 = _mm_castsi128_ps(_mm_setr_epi32(INT_MIN, 0, 0, INT_MIN));
+    const __m128 m1 = _mm_castsi128_ps(_mm_setr_epi32(0, 0, INT_MIN, 0));
+    const __m128 m2 = _mm_castsi128_ps(_mm_setr_epi32(0, INT_MIN, 0, 0));
+    size_t n = num & ~(size_t)3;
+    for (size_t i = 0; i < n; i += 4) {
+        auto *d = (float*)(dst + i);
+        _mm_storeu_ps(d, _mm_xor_ps(_mm_loadu_ps(d), m0));
+        _mm_storeu_ps(d + 4, _mm_xor_ps(_mm_loadu_ps(d + 4), m1));
+        _mm_storeu_ps(d + 8, _mm_xor_ps(_mm_loadu_ps(d + 8), m2));
+    }
+    for (size_t i = n; i < num; ++i)
+        dst[i].x *= -1.0f;
+}
+muTargetSSE42 void InvertX_SSE42(float4 *dst, size_t num)
+{
+    const __m128 m = _mm_castsi128_ps(_mm_setr_epi32(INT_MIN, 0, 0, 0));
+    for (size_t i = 0; i < num; ++i) {
+        auto *d = (float*)(dst + i);
+        _mm_storeu_ps(d, _mm_xor_ps(_mm_loadu_ps(d), m));
+    }
+}
+
+muTargetSSE42 void Scale_SSE42(float *dst, float s, size_t num)
+{
+    const __m128 vs = _mm_set1_ps(s);
+    size_t n = num & ~(size_t)3;
+    for (size_t i = 0; i < n; i += 4)
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_loadu_ps(dst + i), vs));
+    for (size_t i = n; i < num; ++i)
+        dst[i] *= s;
+}
+muTargetSSE42 void Scale_SSE42(float3 *dst, float s, size_t num)
+{
+    Scale_SSE42((float*)dst, s, num * 3);
+}
+
+muTargetSSE42 void Normalize_SSE42(float3 *dst, size_t num)
+{
+    size_t n = num & ~(size_t)3;
+    for (size_t i = 0; i < n; i += 4) {
+        __m128 x, y, z;
+        LoadSoA(dst + i, x, y, z);
+        __m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+        StoreSoA(dst + i, _mm_div_ps(x, len), _mm_div_ps(y, len), _mm_div_ps(z, len));
+    }
+    for (size_t i = n; i < num; ++i)
+        dst[i] = normalize(dst[i]);
+}
+
+muTargetSSE42 void Lerp_SSE42(float *dst, const float *src1, const float *src2, size_t num, float w)
+{
+    const float iw = 1.0f - w;
+    const __m128 vw = _mm_set1_ps(w);
+    const __m128 viw = _mm_set1_ps(iw);
+    size_t n = num & ~(size_t)3;
+    for (size_t i = 0; i < n; i += 4) {
+        __m128 a = _mm_mul_ps(_mm_loadu_ps(src1 + i), vw);
+        __m128 b = _mm_mul_ps(_mm_loadu_ps(src2 + i), viw);
+        _mm_storeu_ps(dst + i, _mm_add_ps(a, b));
+    }
+    for (size_t i = n; i < num; ++i)
+        dst[i] = src1[i] * w + src2[i] * iw;
+}
+
+
+muTargetSSE42 void MinMax_SSE42(const int *src, size_t num, int& dst_min, int& dst_max)
+{
+    if (num < 4) {
+        MinMax_Generic(src, num, dst_min, dst_max);
+        return;
+    }
+    __m128i vmin = _mm_loadu_si128((const __m128i*)src);
+    __m128i vmax = vmin;
+    size_t n = num & ~(size_t)3;
+    for (size_t i = 4; i < n; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        vmin = _mm_min_epi32(vmin, v);
+        vmax = _mm_max_epi32(vmax, v);
+    }
+    int bmin[4], bmax[4];
+    _mm_storeu_si128((__m128i*)bmin, vmin);
+    _mm_storeu_si128((__m128i*)bmax, vmax);
+    int rmin = bmin[0], rmax = bmax[0];
+    for (int j = 1; j < 4; ++j) {
+        rmin = std::min(rmin, bmin[j]);
+        rmax = std::max(rmax, bmax[j]);
+    }
+    for (size_t i = n; i < num; ++i) {
+        rmin = std::min(rmin, src[i]);
+        rmax = std::max(rmax, src[i]);
+    }
+    dst_min = rmin;
+    dst_max = rmax;
+}
+
+// N: components per element. registers are accumulated per lane and reduced to components at the end.
+// (a block of float3 is 4 elements in 3 registers. others fit in 1 register)
+template<int N>
+muTargetSSE42 static inline void MinMaxImpl_SSE42(const float *src, size_t num, float *dst_min, float *dst_max)
+{
+    const int R = N == 3 ? 3 : 1;
+    const size_t E = R * 4 / N;
+
+    if (num == 0)
+        return;
+
+    float rmin[N], rmax[N];
+    size_t i = 0;
+    size_t n = num / E * E;
+    if (n > 0) {
+        __m128 vmin[R], vmax[R];
+        for (int r = 0; r < R; ++r)
+            vmin[r] = vmax[r] = _mm_loadu_ps(src + r * 4);
+        for (i = E; i < n; i += E) {
+            auto *s = src + i * N;
+            for (int r = 0; r < R; ++r) {
+                __m128 v = _mm_loadu_ps(s + r * 4);
+                vmin[r] = _mm_min_ps(vmin[r], v);
+                vmax[r] = _mm_max_ps(vmax[r], v);
+            }
+        }
+        float bmin[R * 4], bmax[R * 4];
+        for (int r = 0; r < R; ++r) {
+            _mm_storeu_ps(bmin + r * 4, vmin[r]);
+            _mm_storeu_ps(bmax + r * 4, vmax[r]);
+        }
+        for (int c = 0; c < N; ++c) {
+            rmin[c] = bmin[c];
+            rmax[c] = bmax[c];
+        }
+        for (int j = N; j < R * 4; ++j) {
+            int c = j % N;
+            rmin[c] = std::min(rmin[c], bmin[j]);
+            rmax[c] = std::max(rmax[c], bmax[j]);
+        }
+    }
+    else {
+        for (int c = 0; c < N; ++c)
+            rmin[c] = rmax[c] = src[c];
+        i = 1;
+    }
+    for (; i < num; ++i) {
+        for (int c = 0; c < N; ++c) {
+            rmin[c] = std::min(rmin[c], src[i * N + c]);
+            rmax[c] = std::max(rmax[c], src[i * N + c]);
+        }
+    }
+    for (int c = 0; c < N; ++c) {
+        dst_min[c] = rmin[c];
+        dst_max[c] = rmax[c];
+    }
+}
+muTargetSSE42 void MinMax_SSE42(const float *src, size_t num, float& dst_min, float& dst_max) { MinMaxImpl_SSE42<1>(src, num, &dst_min, &dst_max); }
+muTargetSSE42 void MinMax_SSE42(const float2 *src, size_t num, float2& dst_min, float2& dst_max) { MinMaxImpl_SSE42<2>((const float*)src, num, (float*)&dst_min, (float*)&dst_max); }
+muTargetSSE42 void MinMax_SSE42(const float3 *src, size_t num, float3& dst_min, float3& dst_max) { MinMaxImpl_SSE42<3>((const float*)src, num, (float*)&dst_min, (float*)&dst_max); }
+muTargetSSE42 void MinMax_SSE42(const float4 *src, size_t num, float4& dst_min, float4& dst_max) { MinMaxImpl_SSE42<4>((const float*)src, num, (float*)&dst_min, (float*)&dst_max); }
+
+muTargetSSE42 bool NearEqual_SSE42(const float *src1, const float *src2, size_t num, float eps)
+{
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(INT_MAX));
+    const __m128 veps = _mm_set1_ps(eps);
+    size_t n = num & ~(size_t)3;
+    for (size_t i = 0; i < n; i += 4) {
+        __m128 d = _mm_and_ps(_mm_sub_ps(_mm_loadu_ps(src1 + i), _mm_loadu_ps(src2 + i)), abs_mask);
+        if (_mm_movemask_ps(_mm_cmplt_ps(d, veps)) != 0xf)
+            return false;
+    }
+    for (size_t i = n; i < num; ++i) {
+        if (!near_equal(src1[i], src2[i], eps))
+            return false;
+    }
+    return true;
+}
+
+template<bool Point>
+muTargetSSE42 static inline void MulImpl_SSE42(const float4x4& m, const float3 src[], float3 dst[], size_t num_data)
+{
+    __m128 c[4][3];
+    for (int i = 0; i < 4; ++i)
+        for (int j = 0; j < 3; ++j)
+            c[i][j] = _mm_set1_ps(m[i][j]);
+
+    size_t n = num_data & ~(size_t)3;
+    for (size_t i = 0; i < n; i += 4) {
+        __m128 x, y, z, r[3];
+        LoadSoA(src + i, x, y, z);
+        for (int j = 0; j < 3; ++j) {
+            r[j] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c[0][j], x), _mm_mul_ps(c[1][j], y)), _mm_mul_ps(c[2][j], z));
+            if (Point)
+                r[j] = _mm_add_ps(r[j], c[3][j]);
+        }
+        StoreSoA(dst + i, r[0], r[1], r[2]);
+    }
+    for (size_t i = n; i < num_data; ++i)
+        dst[i] = Point ? mul_p(m, src[i]) : mul_v(m, src[i]);
+}
+muTargetSSE42 void MulPoints_SSE42(const float4x4& m, const float3 src[], float3 dst[], size_t num_data)
+{
+    MulImpl_SSE42<true>(m, src, dst, num_data);
+}
+muTargetSSE42 void MulVectors_SSE42(const float4x4& m, const float3 src[], float3 dst[], size_t num_data)
+{
+    MulImpl_SSE42<false>(m, src, dst, num_data);
+}
+
+
+// triangle fetchers. fill v with p1.xyz, p2.xyz, p3.xyz of 4 triangles starting at ti.
+struct FetchIndexed_SSE42
+{
+    const float3 *vertices;
+    const int *indices;
+
+    muTargetSSE42 void operator()(int ti, __m128 (&v)[9]) const
+    {
+        auto *idx = indices + ti * 3;
+        for (int k = 0; k < 3; ++k) {
+            auto& p0 = vertices[idx[k]];
+            auto& p1 = vertices[idx[k + 3]];
+            auto& p2 = vertices[idx[k + 6]];
+            auto& p3 = vertices[idx[k + 9]];
+            v[k * 3 + 0] = _mm_setr_ps(p0.x, p1.x, p2.x, p3.x);
+            v[k * 3 + 1] = _mm_setr_ps(p0.y, p1.y, p2.y, p3.y);
+            v[k * 3 + 2] = _mm_setr_ps(p0.z, p1.z, p2.z, p3.z);
+        }
+    }
+};
+struct FetchFlattened_SSE42
+{
+    const float3 *vertices;
+
+    muTargetSSE42 void operator()(int ti, __m128 (&v)[9]) const
+    {
+        auto *p = vertices + ti * 3;
+        for (int k = 0; k < 3; ++k) {
+            v[k * 3 + 0] = _mm_setr_ps(p[k].x, p[k + 3].x, p[k + 6].x, p[k + 9].x);
+            v[k * 3 + 1] = _mm_setr_ps(p[k].y, p[k + 3].y, p[k + 6].y, p[k + 9].y);
+            v[k * 3 + 2] = _mm_setr_ps(p[k].z, p[k + 3].z, p[k + 6].z, p[k + 9].z);
+        }
+    }
+};
+struct FetchSoA_SSE42
+{
+    const float *src[9];
+
+    muTargetSSE42 void operator()(int ti, __m128 (&v)[9]) const
+    {
+        for (int k = 0; k < 9; ++k)
+            v[k] = _mm_loadu_ps(src[k] + ti);
+    }
+};
+
+// same arithmetic as ray_triangle_intersection(). returns mask of hit lanes.
+muTargetSSE42 static inline __m128 RayTriangleIntersection_SSE42(const __m128 (&pos)[3], const __m128 (&dir)[3], const __m128 (&v)[9], __m128& distance)
+{
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(INT_MAX));
+    const __m128 epsdet = _mm_set1_ps(1e-10f);
+    const __m128 neps = _mm_set1_ps(-1e-4f);
+    const __m128 peps = _mm_set1_ps(1.0f + 1e-4f);
+
+    __m128 e1[3], e2[3], t[3];
+    for (int k = 0; k < 3; ++k) {
+        e1[k] = _mm_sub_ps(v[3 + k], v[k]);
+        e2[k] = _mm_sub_ps(v[6 + k], v[k]);
+        t[k] = _mm_sub_ps(pos[k], v[k]);
+    }
+    __m128 p[3] = {
+        _mm_sub_ps(_mm_mul_ps(dir[1], e2[2]), _mm_mul_ps(dir[2], e2[1])),
+        _mm_sub_ps(_mm_mul_ps(dir[2], e2[0]), _mm_mul_ps(dir[0], e2[2])),
+        _mm_sub_ps(_mm_mul_ps(dir[0], e2[1]), _mm_mul_ps(dir[1], e2[0])),
+    };
+    __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1[0], p[0]), _mm_mul_ps(e1[1], p[1])), _mm_mul_ps(e1[2], p[2]));
+    __m128 reject = _mm_cmplt_ps(_mm_and_ps(det, abs_mask), epsdet);
+    __m128 inv_det = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+    __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(t[0], p[0]), _mm_mul_ps(t[1], p[1])), _mm_mul_ps(t[2], p[2])), inv_det);
+    reject = _mm_or_ps(reject, _mm_or_ps(_mm_cmplt_ps(u, neps), _mm_cmpgt_ps(u, peps)));
+
+    __m128 q[3] = {
+        _mm_sub_ps(_mm_mul_ps(t[1], e1[2]), _mm_mul_ps(t[2], e1[1])),
+        _mm_sub_ps(_mm_mul_ps(t[2], e1[0]), _mm_mul_ps(t[0], e1[2])),
+        _mm_sub_ps(_mm_mul_ps(t[0], e1[1]), _mm_mul_ps(t[1], e1[0])),
+    };
+    __m128 vv = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dir[0], q[0]), _mm_mul_ps(dir[1], q[1])), _mm_mul_ps(dir[2], q[2])), inv_det);
+    reject = _mm_or_ps(reject, _mm_or_ps(_mm_cmplt_ps(vv, neps), _mm_cmpgt_ps(_mm_add_ps(u, vv), peps)));
+
+    distance = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2[0], q[0]), _mm_mul_ps(e2[1], q[1])), _mm_mul_ps(e2[2], q[2])), inv_det);
+    return _mm_andnot_ps(reject, _mm_cmpge_ps(distance, _mm_setzero_ps()));
+}
+
+// keeps the nearest hit per lane and reduces lanes at the end. on ties the smaller index wins as in the scalar loop.
+template<class Fetch>
+muTargetSSE42 static inline int RayTrianglesIntersectionImpl_SSE42(float3 pos, float3 dir, const Fetch& fetch, int num_triangles,
+    int& tindex, float& distance, const std::function<bool(int, float&)>& tail)
+{
+    __m128 vpos[3] = { _mm_set1_ps(pos.x), _mm_set1_ps(pos.y), _mm_set1_ps(pos.z) };
+    __m128 vdir[3] = { _mm_set1_ps(dir.x), _mm_set1_ps(dir.y), _mm_set1_ps(dir.z) };
+    __m128 best_d = _mm_set1_ps(FLT_MAX);
+    __m128i best_i = _mm_set1_epi32(-1);
+    __m128i hits = _mm_setzero_si128();
+    __m128i vi = _mm_setr_epi32(0, 1, 2, 3);
+
+    int n = num_triangles & ~3;
+    for (int ti = 0; ti < n; ti += 4) {
+        __m128 v[9], d;
+        fetch(ti, v);
+        __m128 hit = RayTriangleIntersection_SSE42(vpos, vdir, v, d);
+        hits = _mm_sub_epi32(hits, _mm_castps_si128(hit));
+        __m128 closer = _mm_and_ps(hit, _mm_cmplt_ps(d, best_d));
+        best_d = _mm_blendv_ps(best_d, d, closer);
+        best_i = _mm_castps_si128(_mm_blendv_ps(_mm_castsi128_ps(best_i), _mm_castsi128_ps(vi), closer));
+        vi = _mm_add_epi32(vi, _mm_set1_epi32(4));
+    }
+
+    float bd[4];
+    int bi[4], bh[4];
+    _mm_storeu_ps(bd, best_d);
+    _mm_storeu_si128((__m128i*)bi, best_i);
+    _mm_storeu_si128((__m128i*)bh, hits);
+
+    int num_hits = 0;
+    distance = FLT_MAX;
+    for (int l = 0; l < 4; ++l) {
+        num_hits += bh[l];
+        if (bi[l] >= 0 && (bd[l] < distance || (bd[l] == distance && bi[l] < tindex))) {
+            distance = bd[l];
+            tindex = bi[l];
+        }
+    }
+    for (int ti = n; ti < num_triangles; ++ti) {
+        float d;
+        if (tail(ti, d)) {
+            ++num_hits;
+            if (d < distance) {
+                distance = d;
+                tindex = ti;
+            }
+        }
+    }
+    return num_hits;
+}
+
+muTargetSSE42 int RayTrianglesIntersectionIndexed_SSE42(float3 pos, float3 dir, const float3 *vertices, const int *indices, int num_triangles, int& tindex, float& distance)
+{
+    return RayTrianglesIntersectionImpl_SSE42(pos, dir, FetchIndexed_SSE42{ vertices, indices }, num_triangles, tindex, distance,
+        [&](int ti, float& d) {
+            return ray_triangle_intersection(pos, dir, vertices[indices[ti * 3 + 0]], vertices[indices[ti * 3 + 1]], vertices[indices[ti * 3 + 2]], d);
+        });
+}
+muTargetSSE42 int RayTrianglesIntersectionFlattened_SSE42(float3 pos, float3 dir, const float3 *vertices, int num_triangles, int& tindex, float& distance)
+{
+    return RayTrianglesIntersectionImpl_SSE42(pos, dir, FetchFlattened_SSE42{ vertices }, num_triangles, tindex, distance,
+        [&](int ti, float& d) {
+            return ray_triangle_intersection(pos, dir, vertices[ti * 3 + 0], vertices[ti * 3 + 1], vertices[ti * 3 + 2], d);
+        });
+}
+muTargetSSE42 int RayTrianglesIntersectionSoA_SSE42(float3 pos, float3 dir,
+    const float *v1x, const float *v1y, const float *v1z,
+    const float *v2x, const float *v2y, const float *v2z,
+    const float *v3x, const float *v3y, const float *v3z,
+    int num_triangles, int& tindex, float& distance)
+{
+    return RayTrianglesIntersectionImpl_SSE42(pos, dir, FetchSoA_SSE42{ { v1x, v1y, v1z, v2x, v2y, v2z, v3x, v3y, v3z } }, num_triangles, tindex, distance,
+        [&](int ti, float& d) {
+            return ray_triangle_intersection(pos, dir,
+                { v1x[ti], v1y[ti], v1z[ti] }, { v2x[ti], v2y[ti], v2z[ti] }, { v3x[ti], v3y[ti], v3z[ti] }, d);
+        });
+}
+
+
+// face normals are computed 4 triangles at a time. accumulation to vertices is sequential to keep the order of additions.
+template<class Fetch>
+muTargetSSE42 static inline void GenerateNormalsTriangleImpl_SSE42(float3 *dst, const Fetch& fetch,
+    const std::function<float3(int)>& face_normal, const int *indices, int num_triangles, int num_vertices)
+{
+    memset(dst, 0, sizeof(float3)*num_vertices);
+
+    int n = num_triangles & ~3;
+    for (int ti = 0; ti < n; ti += 4) {
+        __m128 v[9], e1[3], e2[3];
+        fetch(ti, v);
+        for (int k = 0; k < 3; ++k) {
+            e1[k] = _mm_sub_ps(v[3 + k], v[k]);
+            e2[k] = _mm_sub_ps(v[6 + k], v[k]);
+        }
+        float nx[4], ny[4], nz[4];
+        _mm_storeu_ps(nx, _mm_sub_ps(_mm_mul_ps(e1[1], e2[2]), _mm_mul_ps(e1[2], e2[1])));
+        _mm_storeu_ps(ny, _mm_sub_ps(_mm_mul_ps(e1[2], e2[0]), _mm_mul_ps(e1[0], e2[2])));
+        _mm_storeu_ps(nz, _mm_sub_ps(_mm_mul_ps(e1[0], e2[1]), _mm_mul_ps(e1[1], e2[0])));
+        for (int l = 0; l < 4; ++l) {
+            float3 fn = { nx[l], ny[l], nz[l] };
+            auto *idx = indices + (ti + l) * 3;
+            for (int ci = 0; ci < 3; ++ci)
+                dst[idx[ci]] += fn;
+        }
+    }
+    for (int ti = n; ti < num_triangles; ++ti) {
+        float3 fn = face_normal(ti);
+        auto *idx = indices + ti * 3;
+        for (int ci = 0; ci < 3; ++ci)
+            dst[idx[ci]] += fn;
+    }
+    Normalize_SSE42(dst, num_vertices);
+}
+
+muTargetSSE42 void GenerateNormalsTriangleIndexed_SSE42(float3 *dst,
+    const float3 *vertices, const int *indices, int num_triangles, int num_vertices)
+{
+    GenerateNormalsTriangleImpl_SSE42(dst, FetchIndexed_SSE42{ vertices, indices },
+        [&](int ti) {
+            float3 p0 = vertices[indices[ti * 3 + 0]];
+            float3 p1 = vertices[indices[ti * 3 + 1]];
+            float3 p2 = vertices[indices[ti * 3 + 2]];
+            return cross(p1 - p0, p2 - p0);
+        },
+        indices, num_triangles, num_vertices);
+}
+muTargetSSE42 void GenerateNormalsTriangleFlattened_SSE42(float3 *dst,
+    const float3 *vertices, const int *indices, int num_triangles, int num_vertices)
+{
+    GenerateNormalsTriangleImpl_SSE42(dst, FetchFlattened_SSE42{ vertices },
+        [&](int ti) {
+            float3 p0 = vertices[ti * 3 + 0];
+            float3 p1 = vertices[ti * 3 + 1];
+            float3 p2 = vertices[ti * 3 + 2];
+            return cross(p1 - p0, p2 - p0);
+        },
+        indices, num_triangles, num_vertices);
+}
+muTargetSSE42 void GenerateNormalsTriangleSoA_SSE42(float3 *dst,
+    const float *v1x, const float *v1y, const float *v1z,
+    const float *v2x, const float *v2y, const float *v2z,
+    const float *v3x, const float *v3y, const float *v3z,
+    const int *indices, int num_triangles, int num_vertices)
+{
+    GenerateNormalsTriangleImpl_SSE42(dst, FetchSoA_SSE42{ { v1x, v1y, v1z, v2x, v2y, v2z, v3x, v3y, v3z } },
+        [&](int ti) {
+            float3 p0 = { v1x[ti], v1y[ti], v1z[ti] };
+            float3 p1 = { v2x[ti], v2y[ti], v2z[ti] };
+            float3 p2 = { v3x[ti], v3y[ti], v3z[ti] };
+            return cross(p1 - p0, p2 - p0);
+        },
+        indices, num_triangles, num_vertices);
+}
+
+
+// ------------------------------------------------------------
+// AVX2
+// ------------------------------------------------------------
+
+muTargetAVX2 uint64_t SumInt32_AVX2(const uint32_t *src, size_t num)
+{
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+    size_t n = num & ~(size_t)7;
+    for (size_t i = 0; i < n; i += 8) {
+        acc0 = _mm256_add_epi64(acc0, _mm256_cvtepu32_epi64(_mm_loadu_si128((const __m128i*)(src + i))));
+        acc1 = _mm256_add_epi64(acc1, _mm256_cvtepu32_epi64(_mm_loadu_si128((const __m128i*)(src + i + 4))));
+    }
+    uint64_t tmp[4];
+    _mm256_storeu_si256((__m256i*)tmp, _mm256_add_epi64(acc0, acc1));
+    uint64_t ret = tmp[0] + tmp[1] + tmp[2] + tmp[3];
+    for (size_t i = n; i < num; ++i)
+        ret += src[i];
+    return ret;
+}
+
+muTargetAVX2 void Scale_AVX2(float *dst, float s, size_t num)
+{
+    const __m256 vs = _mm256_set1_ps(s);
+    size_t n = num & ~(size_t)7;
+    for (size_t i = 0; i < n; i += 8)
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_loadu_ps(dst + i), vs));
+    for (size_t i = n; i < num; ++i)
+        dst[i] *= s;
+}
+muTargetAVX2 void Scale_AVX2(float3 *dst, float s, size_t num)
+{
+    Scale_AVX2((float*)dst, s, num * 3);
+}
+
+muTargetAVX2 void Lerp_AVX2(float *dst, const float *src1, const float *src2, size_t num, float w)
+{
+    const float iw = 1.0f - w;
+    const __m256 vw = _mm256_set1_ps(w);
+    const __m256 viw = _mm256_set1_ps(iw);
+    size_t n = num & ~(size_t)7;
+    for (size_t i = 0; i < n; i += 8) {
+        __m256 a = _mm256_mul_ps(_mm256_loadu_ps(src1 + i), vw);
+        __m256 b = _mm256_mul_ps(_mm256_loadu_ps(src2 + i), viw);
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(a, b));
+    }
+    for (size_t i = n; i < num; ++i)
+        dst[i] = src1[i] * w + src2[i] * iw;
+}
+
+muTargetAVX2 void MinMax_AVX2(const int *src, size_t num, int& dst_min, int& dst_max)
+{
+    if (num < 8) {
+        MinMax_Generic(src, num, dst_min, dst_max);
+        return;
+    }
+    __m256i vmin = _mm256_loadu_si256((const __m256i*)src);
+    __m256i vmax = vmin;
+    size_t n = num & ~(size_t)7;
+    for (size_t i = 8; i < n; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+        vmin = _mm256_min_epi32(vmin, v);
+        vmax = _mm256_max_epi32(vmax, v);
+    }
+    int bmin[8], bmax[8];
+    _mm256_storeu_si256((__m256i*)bmin, vmin);
+    _mm256_storeu_si256((__m256i*)bmax, vmax);
+    int rmin = bmin[0], rmax = bmax[0];
+    for (int j = 1; j < 8; ++j) {
+        rmin = std::min(rmin, bmin[j]);
+        rmax = std::max(rmax, bmax[j]);
+    }
+    for (size_t i = n; i < num; ++i) {
+        rmin = std::min(rmin, src[i]);
+        rmax = std::max(rmax, src[i]);
+    }
+    dst_min = rmin;
+    dst_max = rmax;
+}
+muTargetAVX2 void MinMax_AVX2(const float *src, size_t num, float& dst_min, float& dst_max)
+{
+    if (num < 8) {
+        MinMax_Generic(src, num, dst_min, dst_max);
+        return;
+    }
+    __m256 vmin = _mm256_loadu_ps(src);
+    __m256 vmax = vmin;
+    size_t n = num & ~(size_t)7;
+    for (size_t i = 8; i < n; i += 8) {
+        __m256 v = _mm256_loadu_ps(src + i);
+        vmin = _mm256_min_ps(vmin, v);
+        vmax = _mm256_max_ps(vmax, v);
+    }
+    float bmin[8], bmax[8];
+    _mm256_storeu_ps(bmin, vmin);
+    _mm256_storeu_ps(bmax, vmax);
+    float rmin = bmin[0], rmax = bmax[0];
+    for (int j = 1; j < 8; ++j) {
+        rmin = std::min(rmin, bmin[j]);
+        rmax = std::max(rmax, bmax[j]);
+    }
+    for (size_t i = n; i < num; ++i) {
+        rmin = std::min(rmin, src[i]);
+        rmax = std::max(rmax, src[i]);
+    }
+    dst_min = rmin;
+    dst_max = rmax;
+}
+
+muTargetAVX2 bool NearEqual_AVX2(const float *src1, const float *src2, size_t num, float eps)
+{
+    const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(INT_MAX));
+    const __m256 veps = _mm256_set1_ps(eps);
+    size_t n = num & ~(size_t)7;
+    for (size_t i = 0; i < n; i += 8) {
+        __m256 d = _mm256_and_ps(_mm256_sub_ps(_mm256_loadu_ps(src1 + i), _mm256_loadu_ps(src2 + i)), abs_mask);
+        if (_mm256_movemask_ps(_mm256_cmp_ps(d, veps, _CMP_LT_OQ)) != 0xff)
+            return false;
+    }
+    for (size_t i = n; i < num; ++i) {
+        if (!near_equal(src1[i], src2[i], eps))
+            return false;
+    }
+    return true;
+}
+
+
+// 8 triangles at a time. indexed and flattened vertices are gathered.
+struct FetchIndexed_AVX2
+{
+    const float3 *vertices;
+    const int *indices;
+
+    muTargetAVX2 void operator()(int ti, __m256 (&v)[9]) const
+    {
+        const __m256i stride = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+        auto *base = (const float*)vertices;
+        for (int k = 0; k < 3; ++k) {
+            __m256i vi = _mm256_i32gather_epi32(indices + ti * 3 + k, stride, 4);
+            vi = _mm256_add_epi32(_mm256_add_epi32(vi, vi), vi);
+            v[k * 3 + 0] = _mm256_i32gather_ps(base + 0, vi, 4);
+            v[k * 3 + 1] = _mm256_i32gather_ps(base + 1, vi, 4);
+            v[k * 3 + 2] = _mm256_i32gather_ps(base + 2, vi, 4);
+        }
+    }
+};
+struct FetchFlattened_AVX2
+{
+    const float3 *vertices;
+
+    muTargetAVX2 void operator()(int ti, __m256 (&v)[9]) const
+    {
+        const __m256i stride = _mm256_setr_epi32(0, 9, 18, 27, 36, 45, 54, 63);
+        auto *base = (const float*)(vertices + ti * 3);
+        for (int k = 0; k < 9; ++k)
+            v[k] = _mm256_i32gather_ps(base + k, stride, 4);
+    }
+};
+struct FetchSoA_AVX2
+{
+    const float *src[9];
+
+    muTargetAVX2 void operator()(int ti, __m256 (&v)[9]) const
+    {
+        for (int k = 0; k < 9; ++k)
+            v[k] = _mm256_loadu_ps(src[k] + ti);
+    }
+};
+
+muTargetAVX2 static inline __m256 RayTriangleIntersection_AVX2(const __m256 (&pos)[3], const __m256 (&dir)[3], const __m256 (&v)[9], __m256& distance)
+{
+    const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(INT_MAX));
+    const __m256 epsdet = _mm256_set1_ps(1e-10f);
+    const __m256 neps = _mm256_set1_ps(-1e-4f);
+    const __m256 peps = _mm256_set1_ps(1.0f + 1e-4f);
+
+    __m256 e1[3], e2[3], t[3];
+    for (int k = 0; k < 3; ++k) {
+        e1[k] = _mm256_sub_ps(v[3 + k], v[k]);
+        e2[k] = _mm256_sub_ps(v[6 + k], v[k]);
+        t[k] = _mm256_sub_ps(pos[k], v[k]);
+    }
+    __m256 p[3] = {
+        _mm256_sub_ps(_mm256_mul_ps(dir[1], e2[2]), _mm256_mul_ps(dir[2], e2[1])),
+        _mm256_sub_ps(_mm256_mul_ps(dir[2], e2[0]), _mm256_mul_ps(dir[0], e2[2])),
+        _mm256_sub_ps(_mm256_mul_ps(dir[0], e2[1]), _mm256_mul_ps(dir[1], e2[0])),
+    };
+    __m256 det = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1[0], p[0]), _mm256_mul_ps(e1[1], p[1])), _mm256_mul_ps(e1[2], p[2]));
+    __m256 reject = _mm256_cmp_ps(_mm256_and_ps(det, abs_mask), epsdet, _CMP_LT_OQ);
+    __m256 inv_det = _mm256_div_ps(_mm256_set1_ps(1.0f), det);
+
+    __m256 u = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(t[0], p[0]), _mm256_mul_ps(t[1], p[1])), _mm256_mul_ps(t[2], p[2])), inv_det);
+    reject = _mm256_or_ps(reject, _mm256_or_ps(_mm256_cmp_ps(u, neps, _CMP_LT_OQ), _mm256_cmp_ps(u, peps, _CMP_GT_OQ)));
+
+    __m256 q[3] = {
+        _mm256_sub_ps(_mm256_mul_ps(t[1], e1[2]), _mm256_mul_ps(t[2], e1[1])),
+        _mm256_sub_ps(_mm256_mul_ps(t[2], e1[0]), _mm256_mul_ps(t[0], e1[2])),
+        _mm256_sub_ps(_mm256_mul_ps(t[0], e1[1]), _mm256_mul_ps(t[1], e1[0])),
+    };
+    __m256 vv = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dir[0], q[0]), _mm256_mul_ps(dir[1], q[1])), _mm256_mul_ps(dir[2], q[2])), inv_det);
+    reject = _mm256_or_ps(reject, _mm256_or_ps(_mm256_cmp_ps(vv, neps, _CMP_LT_OQ), _mm256_cmp_ps(_mm256_add_ps(u, vv), peps, _CMP_GT_OQ)));
+
+    distance = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2[0], q[0]), _mm256_mul_ps(e2[1], q[1])), _mm256_mul_ps(e2[2], q[2])), inv_det);
+    return _mm256_andnot_ps(reject, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_GE_OQ));
+}
+
+template<class Fetch>
+muTargetAVX2 static inline int RayTrianglesIntersectionImpl_AVX2(float3 pos, float3 dir, const Fetch& fetch, int num_triangles,
+    int& tindex, float& distance, const std::function<bool(int, float&)>& tail)
+{
+    __m256 vpos[3] = { _mm256_set1_ps(pos.x), _mm256_set1_ps(pos.y), _mm256_set1_ps(pos.z) };
+    __m256 vdir[3] = { _mm256_set1_ps(dir.x), _mm256_set1_ps(dir.y), _mm256_set1_ps(dir.z) };
+    __m256 best_d = _mm256_set1_ps(FLT_MAX);
+    __m256i best_i = _mm256_set1_epi32(-1);
+    __m256i hits = _mm256_setzero_si256();
+    __m256i vi = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    int n = num_triangles & ~7;
+    for (int ti = 0; ti < n; ti += 8) {
+        __m256 v[9], d;
+        fetch(ti, v);
+        __m256 hit = RayTriangleIntersection_AVX2(vpos, vdir, v, d);
+        hits = _mm256_sub_epi32(hits, _mm256_castps_si256(hit));
+        __m256 closer = _mm256_and_ps(hit, _mm256_cmp_ps(d, best_d, _CMP_LT_OQ));
+        best_d = _mm256_blendv_ps(best_d, d, closer);
+        best_i = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(best_i), _mm256_castsi256_ps(vi), closer));
+        vi = _mm256_add_epi32(vi, _mm256_set1_epi32(8));
+    }
+
+    float bd[8];
+    int bi[8], bh[8];
+    _mm256_storeu_ps(bd, best_d);
+    _mm256_storeu_si256((__m256i*)bi, best_i);
+    _mm256_storeu_si256((__m256i*)bh, hits);
+
+    int num_hits = 0;
+    distance = FLT_MAX;
+    for (int l = 0; l < 8; ++l) {
+        num_hits += bh[l];
+        if (bi[l] >= 0 && (bd[l] < distance || (bd[l] == distance && bi[l] < tindex))) {
+            distance = bd[l];
+            tindex = bi[l];
+        }
+    }
+    for (int ti = n; ti < num_triangles; ++ti) {
+        float d;
+        if (tail(ti, d)) {
+            ++num_hits;
+            if (d < distance) {
+                distance = d;
+                tindex = ti;
+            }
+        }
+    }
+    return num_hits;
+}
+
+muTargetAVX2 int RayTrianglesIntersectionIndexed_AVX2(float3 pos, float3 dir, const float3 *vertices, const int *indices, int num_triangles, int& tindex, float& distance)
+{
+    return RayTrianglesIntersectionImpl_AVX2(pos, dir, FetchIndexed_AVX2{ vertices, indices }, num_triangles, tindex, distance,
+        [&](int ti, float& d) {
+            return ray_triangle_intersection(pos, dir, vertices[indices[ti * 3 + 0]], vertices[indices[ti * 3 + 1]], vertices[indices[ti * 3 + 2]], d);
+        });
+}
+muTargetAVX2 int RayTrianglesIntersectionFlattened_AVX2(float3 pos, float3 dir, const float3 *vertices, int num_triangles, int& tindex, float& distance)
+{
+    return RayTrianglesIntersectionImpl_AVX2(pos, dir, FetchFlattened_AVX2{ vertices }, num_triangles, tindex, distance,
+        [&](int ti, float& d) {
+            return ray_triangle_intersection(pos, dir, vertices[ti * 3 + 0], vertices[ti * 3 + 1], vertices[ti * 3 + 2], d);
+        });
+}
+muTargetAVX2 int RayTrianglesIntersectionSoA_AVX2(float3 pos, float3 dir,
+    const float *v1x, const float *v1y, const float *v1z,
+    const float *v2x, const float *v2y, const float *v2z,
+    const float *v3x, const float *v3y, const float *v3z,
+    int num_triangles, int& tindex, float& distance)
+{
+    return RayTrianglesIntersectionImpl_AVX2(pos, dir, FetchSoA_AVX2{ { v1x, v1y, v1z, v2x, v2y, v2z, v3x, v3y, v3z } }, num_triangles, tindex, distance,
+        [&](int ti, float& d) {
+            return ray_triangle_intersection(pos, dir,
+                { v1x[ti], v1y[ti], v1z[ti] }, { v2x[ti], v2y[ti], v2z[ti] }, { v3x[ti], v3y[ti], v3z[ti] }, d);
+        });
+}
+
+} // namespace mu
+
+#undef muTargetSSE42
+#undef muTargetAVX2
+#endif // muEnableIntrinsics
@@ -48,7 +48,10 @@ static void Send(ms::Scene& scene)
 TestCase(Test_SendMesh)
 {
     auto osc = ms::OpenOSceneCacheFile("wave.sc", { ms::SceneCacheEncoding::Plain });
-    auto oscz = ms::OpenOSceneCacheFile("wave.scz", { ms::SceneCacheEncoding::ZSTD });
+    ms::SceneCacheSettings scz_settings;
+    scz_settings.encoding = ms::SceneCacheEncoding::ZSTD;
+    scz_settings.keyframe_interval = 4;
+    auto oscz = ms::OpenOSceneCacheFile("wave.scz", scz_settings);
 
     for (int i = 0; i < 8; ++i) {
         auto scene = ms::Scene::create();
@@ -84,6 +87,12 @@ TestCase(Test_SceneCacheRead)
     if (!isc)
         return;
 
+    {
+        // partial load
+        auto scene = isc->getByIndex(0, { "/Test/Wave" });
+        Expect(scene && scene->entities.size() == 1);
+    }
+
     auto range = isc->getTimeRange();
     float step = 0.1f;
     for (float t = std::get<0>(range); t < std::get<1>(range); t += step) {
@@ -96,6 +105,184 @@ TestCase(Test_SceneCacheRead)
     }
 }
 
+TestCase(Test_MeshEncode)
+{
+    auto src = ms::Mesh::create();
+    GenerateWaveMesh(src->counts, src->indices, src->points, src->uv0, 2.0f, 1.0f, 64, 0.0f);
+    src->material_ids.resize(src->counts.size(), 0);
+    mu::GenerateNormalsPoly(src->normals, src->points, src->counts, src->indices, false);
+    src->setupFlags();
+
+    auto serialize = [](ms::Mesh& mesh, const ms::MeshEncodeSettings& es) {
+        ms::MemoryStream os;
+        mesh.serialize(os, es);
+        os.flush();
+        return os.getBuffer();
+    };
+    ms::MeshEncodeSettings es = { 0 };
+    auto plain = serialize(*src, es);
+
+    es.quantize_points = es.quantize_normals = es.quantize_uv = es.pack_indices = 1;
+    auto encoded = serialize(*src, es);
+    Expect(encoded.size() * 2 < plain.size());
+
+    ms::MemoryStream is;
+    is.swap(encoded);
+    auto dst = std::static_pointer_cast<ms::Mesh>(ms::Entity::create(is));
+    Expect(dst->points.size() == src->points.size() && NearEqual(dst->points.data(), src->points.data(), src->points.size(), 0.001f));
+    Expect(dst->normals.size() == src->normals.size() && NearEqual(dst->normals.data(), src->normals.data(), src->normals.size(), 0.01f));
+    Expect(dst->uv0.size() == src->uv0.size() && NearEqual(dst->uv0.data(), src->uv0.data(), src->uv0.size(), 0.001f));
+    Expect(dst->counts == src->counts && dst->indices == src->indices && dst->material_ids == src->material_ids);
+}
+
+TestCase(Test_MeshEncodeMessage)
+{
+    auto src = ms::Mesh::create();
+    src->path = "/Test/MeshEncodeMessage";
+    GenerateWaveMesh(src->counts, src->indices, src->points, src->uv0, 2.0f, 1.0f, 64, 0.0f);
+    src->material_ids.resize(src->counts.size(), 0);
+    mu::GenerateNormalsPoly(src->normals, src->points, src->counts, src->indices, false);
+    src->colors.resize(src->points.size(), { 1.0f, 0.5f, 0.25f, 1.0f });
+    src->setupFlags();
+    auto& es = src->encode_settings;
+    es.quantize_points = es.quantize_normals = es.quantize_uv = es.quantize_colors = es.pack_indices = 1;
+
+    ms::SetMessage mes;
+    mes.scene.entities.push_back(src);
+
+    ms::MemoryStream os;
+    mes.serialize(os);
+    os.flush();
+    auto buf = os.getBuffer();
+
+    // the validation hash must survive quantization on both deserialize paths
+    auto check = [&](ms::SetMessage& dst) {
+        Expect(dst.scene.entities.size() == 1);
+        auto& mesh = static_cast<ms::Mesh&>(*dst.scene.entities[0]);
+        Expect(mesh.points.size() == src->points.size() && NearEqual(mesh.points.data(), src->points.data(), src->points.size(), 0.001f));
+        Expect(mesh.indices == src->indices);
+    };
+    {
+        auto tmp = buf;
+        ms::MemoryStream is;
+        is.swap(tmp);
+        ms::SetMessage dst;
+        bool ok = true;
+        try { dst.deserialize(is); }
+        catch (const std::runtime_error&) { ok = false; }
+        Expect(ok);
+        if (ok)
+            check(dst);
+    }
+    {
+        ms::MemoryStream is;
+        is.swap(buf);
+        ms::SetMessage dst;
+        bool ok = true;
+        try { dst.deserialize(is, [](ms::TransformPtr&) {}); }
+        catch (const std::runtime_error&) { ok = false; }
+        Expect(ok);
+        if (ok)
+            check(dst);
+    }
+}
+
+TestCase(Test_MeshDelta)
+{
+    auto base = ms::Mesh::create();
+    base->path = "/Test/MeshDelta";
+    GenerateWaveMesh(base->counts, base->indices, base->points, base->uv0, 2.0f, 1.0f, 64, 0.0f);
+    mu::GenerateNormalsPoly(base->normals, base->points, base->counts, base->indices, false);
+    base->setupFlags();
+
+    // move a few vertices as sculpting does
+    auto src = std::static_pointer_cast<ms::Mesh>(base->clone());
+    src->position = { 1.0f, 0.0f, 0.0f };
+    for (int i = 100; i < 110; ++i)
+        src->points[i].y += 0.1f;
+    src->points[2000].y -= 0.1f;
+
+    ms::DeltaMessage mes;
+    Expect(src->diff(*base, mes.delta));
+    Expect(mes.delta.points.ranges.size() == 4 && mes.delta.normals.empty() && mes.delta.uv0.empty());
+    mes.delta.base_checksum = base->checksumGeom();
+    mes.delta.checksum = src->checksumGeom();
+
+    ms::MemoryStream os;
+    mes.serialize(os);
+    os.flush();
+    auto buf = os.getBuffer();
+    Expect(buf.size() < src->points.size() * sizeof(float3) / 10);
+
+    ms::MemoryStream is;
+    is.swap(buf);
+    ms::DeltaMessage dst;
+    dst.deserialize(is);
+    auto patched = std::static_pointer_cast<ms::Mesh>(base->clone());
+    Expect(dst.delta.base_checksum == patched->checksumGeom());
+    Expect(patched->patch(dst.delta));
+    Expect(patched->checksumGeom() == dst.delta.checksum);
+    Expect(patched->points == src->points && patched->position == src->position);
+
+    // nor can a root bone change
+    {
+        auto moved = std::static_pointer_cast<ms::Mesh>(src->clone());
+        moved->root_bone = "/Test/Root";
+        Expect(!moved->diff(*base, mes.delta));
+    }
+
+    // topology change can't be a delta
+    src->indices.pop_back();
+    src->counts.back() -= 1;
+    Expect(!src->diff(*base, mes.delta));
+}
+
+TestCase(Test_StreamingDeserialize)
+{
+    ms::SetMessage src;
+    for (int i = 0; i < 4; ++i) {
+        auto mesh = ms::Mesh::create();
+        mesh->path = "/Test/Streaming" + std::to_string(i);
+        GenerateIcoSphereMesh(mesh->counts, mesh->indices, mesh->points, mesh->uv0, 1.0f, 4);
+        mesh->setupFlags();
+        src.scene.entities.push_back(mesh);
+    }
+    src.use_delta = true;
+
+    ms::MemoryStream os;
+    src.serialize(os);
+    os.flush();
+    auto buf = os.getBuffer();
+
+    // refine each entity as soon as it is read, as the server does
+    ms::MemoryStream is;
+    is.swap(buf);
+    ms::SetMessage dst;
+    mu::task_group tasks;
+    int num_entities = 0;
+    bool use_delta = false;
+    dst.deserialize(is, [&](ms::TransformPtr& obj) {
+        ++num_entities;
+        // read before entities. the server decides whether to retain them while receiving.
+        use_delta = dst.use_delta;
+        tasks.run([obj]() {
+            auto& mesh = static_cast<ms::Mesh&>(*obj);
+            mesh.refine_settings.flags.triangulate = 1;
+            mesh.refine(mesh.refine_settings);
+        });
+    });
+    tasks.wait();
+    Expect(num_entities == 4 && dst.scene.entities.size() == 4);
+    Expect(use_delta);
+
+    bool ok = true;
+    for (int i = 0; i < 4; ++i) {
+        auto& mesh = static_cast<ms::Mesh&>(*dst.scene.entities[i]);
+        ok = ok && mesh.path == src.scene.entities[i]->path && !mesh.submeshes.empty();
+    }
+    Expect(ok);
+}
+
 TestCase(Test_Animation)
 {
     ms::Scene scene;
@@ -87,7 +87,8 @@ TestCase(TestMeshRefiner)
     }
 
     RawVector<float3> normals;
-    GenerateNormalsWithSmoothAngle(normals, points, counts, indices, 40.0f, false);
+    MeshConnectionInfo connection;
+    GenerateNormalsWithSmoothAngle(normals, points, counts, indices, 40.0f, false, connection);
 
     RawVector<float2> uv_refined;
     RawVector<float3> normals_refined;
@@ -98,13 +99,28 @@ TestCase(TestMeshRefiner)
     refiner.counts = counts;
     refiner.indices = indices;
     refiner.points = points;
+    refiner.connection.swap(connection);
 
     refiner.addExpandedAttribute<float2>(uv_flattened, uv_refined, remap_uv);
     refiner.addExpandedAttribute<float3>(normals, normals_refined, remap_normals);
 
+    // the connection built for normals must be reused
+    const int *v2f_indices = refiner.connection.v2f_indices.data();
     refiner.refine();
+    Expect(refiner.connection.v2f_indices.data() == v2f_indices);
     refiner.retopology(false);
     refiner.genSubmeshes(material_ids);
+
+    // every corner must be refined to a vertex with the same position and attributes, and splits must not exceed split_unit
+    for (auto& split : refiner.splits)
+        Expect(split.vertex_count <= refiner.split_unit);
+    Expect(refiner.new_indices.size() == indices.size());
+    for (int ii = 0; ii < (int)indices.size(); ++ii) {
+        int ni = refiner.new_indices[ii];
+        Expect(refiner.new_points[ni] == points[indices[ii]]);
+        Expect(uv_refined[ni] == uv_flattened[ii]);
+        Expect(normals_refined[ni] == normals[ii]);
+    }
 }
 
 
@@ -199,6 +215,15 @@ TestCase(TestNormalsAndTangents)
     ValidateNormals(normals[1]);
 #endif
 
+#ifdef muEnableIntrinsics
+    if (GetSIMDLevel() >= SIMDLevel::SSE42) {
+        TestScope("GenerateNormals indexed SSE4.2", [&]() {
+            GenerateNormalsTriangleIndexed_SSE42(normals[1].data(), points.data(), indices.data(), num_triangles, num_points);
+        }, num_try);
+        ValidateNormals(normals[1]);
+    }
+#endif
+
     TestScope("GenerateNormals flattened C++", [&]() {
         GenerateNormalsTriangleFlattened_Generic(normals[2].data(), points_f.data(), indices.data(), num_triangles, num_points);
     }, num_try);
@@ -211,6 +236,15 @@ TestCase(TestNormalsAndTangents)
     ValidateNormals(normals[3]);
 #endif
 
+#ifdef muEnableIntrinsics
+    if (GetSIMDLevel() >= SIMDLevel::SSE42) {
+        TestScope("GenerateNormals flattened SSE4.2", [&]() {
+            GenerateNormalsTriangleFlattened_SSE42(normals[3].data(), points_f.data(), indices.data(), num_triangles, num_points);
+        }, num_try);
+        ValidateNormals(normals[3]);
+    }
+#endif
+
     TestScope("GenerateNormals SoA C++", [&]() {
         GenerateNormalsTriangleSoA_Generic(normals[4].data(), SoAPointsArgs, indices.data(), num_triangles, num_points);
     }, num_try);
@@ -223,6 +257,15 @@ TestCase(TestNormalsAndTangents)
     ValidateNormals(normals[5]);
 #endif
 
+#ifdef muEnableIntrinsics
+    if (GetSIMDLevel() >= SIMDLevel::SSE42) {
+        TestScope("GenerateNormals SoA SSE4.2", [&]() {
+            GenerateNormalsTriangleSoA_SSE42(normals[5].data(), SoAPointsArgs, indices.data(), num_triangles, num_points);
+        }, num_try);
+        ValidateNormals(normals[5]);
+    }
+#endif
+
 
     // generate tangents
 
@@ -357,6 +400,14 @@ TestCase(TestMulPoints)
         Print("    *** validation failed ***\n");
     }
 #endif
+#ifdef muEnableIntrinsics
+    if (GetSIMDLevel() >= SIMDLevel::SSE42) {
+        TestScope("MulPoints SSE4.2", [&]() {
+            MulPoints_SSE42(matrix, src.data(), dst2.data(), num_data);
+        }, num_try);
+        Expect(NearEqual(dst1.data(), dst2.data(), num_data));
+    }
+#endif
 
     TestScope("MulVectors C++", [&]() {
         MulVectors_Generic(matrix, src.data(), dst1.data(), num_data);
@@ -369,6 +420,14 @@ TestCase(TestMulPoints)
         Print("    *** validation failed ***\n");
     }
 #endif
+#ifdef muEnableIntrinsics
+    if (GetSIMDLevel() >= SIMDLevel::SSE42) {
+        TestScope("MulVectors SSE4.2", [&]() {
+            MulVectors_SSE42(matrix, src.data(), dst2.data(), num_data);
+        }, num_try);
+        Expect(NearEqual(dst1.data(), dst2.data(), num_data));
+    }
+#endif
 }
 
 
@@ -452,6 +511,23 @@ TestCase(TestRayTrianglesIntersection)
     PrintResult();
 #endif
 
+#ifdef muEnableIntrinsics
+    if (GetSIMDLevel() >= SIMDLevel::SSE42) {
+        TestScope("RayTrianglesIntersection indexed SSE4.2", [&]() {
+            num_hits = RayTrianglesIntersectionIndexed_SSE42(ray_pos, ray_dir, vertices.data(),
+                indices.data(), num_triangles, tindex, distance);
+        }, num_try);
+        PrintResult();
+    }
+    if (GetSIMDLevel() >= SIMDLevel::AVX2) {
+        TestScope("RayTrianglesIntersection indexed AVX2", [&]() {
+            num_hits = RayTrianglesIntersectionIndexed_AVX2(ray_pos, ray_dir, vertices.data(),
+                indices.data(), num_triangles, tindex, distance);
+        }, num_try);
+        PrintResult();
+    }
+#endif
+
     TestScope("RayTrianglesIntersection flattened C++", [&]() {
         num_hits = RayTrianglesIntersectionFlattened_Generic(ray_pos, ray_dir, vertices_flattened.data(), num_triangles, tindex, distance);
     }, num_try);
@@ -464,6 +540,21 @@ TestCase(TestRayTrianglesIntersection)
     PrintResult();
 #endif
 
+#ifdef muEnableIntrinsics
+    if (GetSIMDLevel() >= SIMDLevel::SSE42) {
+        TestScope("RayTrianglesIntersection flattened SSE4.2", [&]() {
+            num_hits = RayTrianglesIntersectionFlattened_SSE42(ray_pos, ray_dir, vertices_flattened.data(), num_triangles, tindex, distance);
+        }, num_try);
+        PrintResult();
+    }
+    if (GetSIMDLevel() >= SIMDLevel::AVX2) {
+        TestScope("RayTrianglesIntersection flattened AVX2", [&]() {
+            num_hits = RayTrianglesIntersectionFlattened_AVX2(ray_pos, ray_dir, vertices_flattened.data(), num_triangles, tindex, distance);
+        }, num_try);
+        PrintResult();
+    }
+#endif
+
     TestScope("RayTrianglesIntersection SoA C++", [&]() {
         num_hits = RayTrianglesIntersectionSoA_Generic(ray_pos, ray_dir,
             v1x.data(), v1y.data(), v1z.data(),
@@ -481,6 +572,27 @@ TestCase(TestRayTrianglesIntersection)
     }, num_try);
     PrintResult();
 #endif
+
+#ifdef muEnableIntrinsics
+    if (GetSIMDLevel() >= SIMDLevel::SSE42) {
+        TestScope("RayTrianglesIntersection SoA SSE4.2", [&]() {
+            num_hits = RayTrianglesIntersectionSoA_SSE42(ray_pos, ray_dir,
+                v1x.data(), v1y.data(), v1z.data(),
+                v2x.data(), v2y.data(), v2z.data(),
+                v3x.data(), v3y.data(), v3z.data(), num_triangles, tindex, distance);
+        }, num_try);
+        PrintResult();
+    }
+    if (GetSIMDLevel() >= SIMDLevel::AVX2) {
+        TestScope("RayTrianglesIntersection SoA AVX2", [&]() {
+            num_hits = RayTrianglesIntersectionSoA_AVX2(ray_pos, ray_dir,
+                v1x.data(), v1y.data(), v1z.data(),
+                v2x.data(), v2y.data(), v2z.data(),
+                v3x.data(), v3y.data(), v3z.data(), num_triangles, tindex, distance);
+        }, num_try);
+        PrintResult();
+    }
+#endif
 }
 
 
@@ -730,12 +842,285 @@ TestCase(TestSum)
         auto sum = SumInt32_ISPC((uint32_t*)input.data(), input.size());
         Print("sum: %llu\n", sum);
     }, 1);
+#ifdef muEnableIntrinsics
+    if (GetSIMDLevel() >= SIMDLevel::SSE42) {
+        TestScope("SumInt32_SSE42", [&]() {
+            auto sum = SumInt32_SSE42((uint32_t*)input.data(), input.size());
+            Print("sum: %llu\n", sum);
+        }, 1);
+    }
+    if (GetSIMDLevel() >= SIMDLevel::AVX2) {
+        TestScope("SumInt32_AVX2", [&]() {
+            auto sum = SumInt32_AVX2((uint32_t*)input.data(), input.size());
+            Print("sum: %llu\n", sum);
+        }, 1);
+    }
+#endif
     TestScope("SumInt32", [&]() {
         auto sum = SumInt32(input.data(), sizeof(float) * input.size());
         Print("sum: %llu\n", sum);
     }, 1);
 }
 
+TestCase(TestSIMDKernels)
+{
+    const size_t num_data = 1000003; // not a multiple of SIMD width to cover remainders
+    const int num_try = 20;
+
+    RawVector<float3> src, dst1, dst2;
+    src.resize(num_data);
+    for (size_t i = 0; i < num_data; ++i)
+        src[i] = { std::sin((float)i * 0.1f), std::cos((float)i * 0.05f), (float)(i % 100) * 0.02f - 1.0f };
+
+    auto flat = (const float*)src.data();
+    size_t num_flat = num_data * 3;
+
+    Print("    level: %d\n", (int)GetSIMDLevel());
+
+    // all variants must produce identical results to the C++ version
+    auto Validate = [](const void *a, const void *b, size_t size) {
+        Expect(memcmp(a, b, size) == 0);
+    };
+
+    float3 min1, max1, min2, max2;
+    TestScope("MinMax float3 C++", [&]() {
+        MinMax_Generic(src.data(), num_data, min1, max1);
+    }, num_try);
+#ifdef muEnableISPC
+    TestScope("MinMax float3 ISPC", [&]() {
+        MinMax_ISPC(src.data(), num_data, min2, max2);
+    }, num_try);
+#endif
+#ifdef muEnableIntrinsics
+    if (GetSIMDLevel() >= SIMDLevel::SSE42) {
+        TestScope("MinMax float3 SSE4.2", [&]() {
+            MinMax_SSE42(src.data(), num_data, min2, max2);
+        }, num_try);
+        Expect(min1 == min2 && max1 == max2);
+    }
+#endif
+
+    float fmin1, fmax1, fmin2, fmax2;
+    TestScope("MinMax float C++", [&]() {
+        MinMax_Generic(flat, num_flat, fmin1, fmax1);
+    }, num_try);
+#ifdef muEnableISPC
+    TestScope("MinMax float ISPC", [&]() {
+        MinMax_ISPC(flat, num_flat, fmin2, fmax2);
+    }, num_try);
+#endif
+#ifdef muEnableIntrinsics
+    if (GetSIMDLevel() >= SIMDLevel::SSE42) {
+        TestScope("MinMax float SSE4.2", [&]() {
+            MinMax_SSE42(flat, num_flat, fmin2, fmax2);
+        }, num_try);
+        Expect(fmin1 == fmin2 && fmax1 == fmax2);
+    }
+    if (GetSIMDLevel() >= SIMDLevel::AVX2) {
+        TestScope("MinMax float AVX2", [&]() {
+            MinMax_AVX2(flat, num_flat, fmin2, fmax2);
+        }, num_try);
+        Expect(fmin1 == fmin2 && fmax1 == fmax2);
+    }
+#endif
+
+    TestScope("Normalize C++", [&]() {
+        dst1 = src;
+        Normalize_Generic(dst1.data(), num_data);
+    }, num_try);
+#ifdef muEnableISPC
+    TestScope("Normalize ISPC", [&]() {
+        dst2 = src;
+        Normalize_ISPC(dst2.data(), num_data);
+    }, num_try);
+#endif
+#ifdef muEnableIntrinsics
+    if (GetSIMDLevel() >= SIMDLevel::SSE42) {
+        TestScope("Normalize SSE4.2", [&]() {
+            dst2 = src;
+            Normalize_SSE42(dst2.data(), num_data);
+        }, num_try);
+        Validate(dst1.data(), dst2.data(), sizeof(float3) * num_data);
+    }
+#endif
+
+    RawVector<float> lerp1(num_flat), lerp2(num_flat);
+    auto flat2 = (const float*)src.data() + 1;
+    TestScope("Lerp C++", [&]() {
+        Lerp_Generic(lerp1.data(), flat, flat2, num_flat - 1, 0.3f);
+    }, num_try);
+#ifdef muEnableISPC
+    TestScope("Lerp ISPC", [&]() {
+        Lerp_ISPC(lerp2.data(), flat, flat2, num_flat - 1, 0.3f);
+    }, num_try);
+#endif
+#ifdef muEnableIntrinsics
+    if (GetSIMDLevel() >= SIMDLevel::SSE42) {
+        TestScope("Lerp SSE4.2", [&]() {
+            Lerp_SSE42(lerp2.data(), flat, flat2, num_flat - 1, 0.3f);
+        }, num_try);
+        Validate(lerp1.data(), lerp2.data(), sizeof(float) * (num_flat - 1));
+    }
+    if (GetSIMDLevel() >= SIMDLevel::AVX2) {
+        TestScope("Lerp AVX2", [&]() {
+            Lerp_AVX2(lerp2.data(), flat, flat2, num_flat - 1, 0.3f);
+        }, num_try);
+        Validate(lerp1.data(), lerp2.data(), sizeof(float) * (num_flat - 1));
+    }
+#endif
+
+    RawVector<snorm16> s16_1(num_flat), s16_2(num_flat);
+    TestScope("F32ToS16 C++", [&]() {
+        F32ToS16_Generic(s16_1.data(), flat, num_flat);
+    }, num_try);
+#ifdef muEnableISPC
+    TestScope("F32ToS16 ISPC", [&]() {
+        F32ToS16_ISPC(s16_2.data(), flat, num_flat);
+    }, num_try);
+#endif
+#ifdef muEnableIntrinsics
+    if (GetSIMDLevel() >= SIMDLevel::SSE42) {
+        TestScope("F32ToS16 SSE4.2", [&]() {
+            F32ToS16_SSE42(s16_2.data(), flat, num_flat);
+        }, num_try);
+        Validate(s16_1.data(), s16_2.data(), sizeof(snorm16) * num_flat);
+
+        RawVector<float> f1(num_flat), f2(num_flat);
+        S16ToF32_Generic(f1.data(), s16_1.data(), num_flat);
+        S16ToF32_SSE42(f2.data(), s16_1.data(), num_flat);
+        Validate(f1.data(), f2.data(), sizeof(float) * num_flat);
+    }
+#endif
+
+    RawVector<half> h1(num_flat), h2(num_flat);
+    TestScope("F32ToF16 C++", [&]() {
+        F32ToF16_Generic(h1.data(), flat, num_flat);
+    }, num_try);
+#ifdef muEnableISPC
+    TestScope("F32ToF16 ISPC", [&]() {
+        F32ToF16_ISPC(h2.data(), flat, num_flat);
+    }, num_try);
+#endif
+#ifdef muEnableIntrinsics
+    if (GetSIMDLevel() >= SIMDLevel::SSE42) {
+        TestScope("F32ToF16 SSE4.2", [&]() {
+            F32ToF16_SSE42(h2.data(), flat, num_flat);
+        }, num_try);
+        Validate(h1.data(), h2.data(), sizeof(half) * num_flat);
+    }
+#endif
+}
+
+TestCase(TestHash)
+{
+    const size_t input_size = 10000000;
+
+    RawVector<float> input(input_size);
+    for (int i = 0; i < input_size; ++i)
+        input[i] = (float)i;
+
+    uint64_t h1 = 0, h2 = 0;
+    TestScope("Hash64_Generic", [&]() {
+        h1 = Hash64_Generic(input.data(), sizeof(float) * input.size());
+        Print("hash: %llx\n", h1);
+    }, 1);
+    TestScope("Hash64", [&]() {
+        h2 = Hash64(input.data(), sizeof(float) * input.size());
+        Print("hash: %llx\n", h2);
+    }, 1);
+    Expect(Hash64(input.data(), sizeof(float) * input.size()) == h2);
+
+    // xxHash64 reference values. input is the sanity test buffer of xxhsum.
+    // covers the 4 lane loop (>= 32 bytes) and 8, 4 and 1 byte tails, with and without seed.
+    {
+        const uint64_t prime32 = 2654435761ULL;
+        uint8_t buf[256];
+        uint64_t gen = prime32;
+        for (auto& b : buf) {
+            b = (uint8_t)(gen >> 56);
+            gen *= 11400714785074694797ULL;
+        }
+
+        struct { size_t size; uint64_t seed, hash; } refs[] = {
+            {   0, 0,       0xEF46DB3751D8E999ULL },
+            {   0, prime32, 0xAC75FDA2929B17EFULL },
+            {   1, 0,       0xE934A84ADB052768ULL },
+            {   1, prime32, 0x5014607643A9B4C3ULL },
+            {   4, 0,       0x9136A0DCA57457EEULL },
+            {   8, 0,       0xCDBCF538E71D1348ULL },
+            {  14, 0,       0x8282DCC4994E35C8ULL },
+            {  14, prime32, 0xC3BD6BF63DEB6DF0ULL },
+            {  31, 0,       0x299B39A290E6D783ULL },
+            {  32, 0,       0x18B216492BB44B70ULL },
+            {  32, prime32, 0xB3F33BDF93ADE409ULL },
+            { 100, 0,       0x4BFE019CD91D9EA4ULL },
+            { 222, 0,       0xB641AE8CB691C174ULL },
+            { 222, prime32, 0x20CB8AB7AE10C14AULL },
+        };
+        for (auto& r : refs) {
+            Expect(Hash64_Generic(buf, r.size, r.seed) == r.hash);
+            Expect(Hash64(buf, r.size, r.seed) == r.hash);
+        }
+    }
+
+    // unlike SumInt32(), swapped elements must be detected
+    auto sum = SumInt32(input.data(), sizeof(float) * input.size());
+    std::swap(input[10], input[20]);
+    Expect(SumInt32(input.data(), sizeof(float) * input.size()) == sum);
+    Expect(Hash64(input.data(), sizeof(float) * input.size()) != h2);
+}
+
+TestCase(Test_FlatHashMap)
+{
+    const int num = 100000;
+
+    std::vector<std::string> keys(num);
+    for (int i = 0; i < num; ++i)
+        keys[i] = "/root/node" + std::to_string(i);
+
+    flat_hash_map<std::string, int> fmap;
+    std::map<std::string, int> smap;
+    TestScope("flat_hash_map insert", [&]() {
+        for (int i = 0; i < num; ++i)
+            fmap[keys[i]] = i;
+    }, 1);
+    TestScope("std::map insert", [&]() {
+        for (int i = 0; i < num; ++i)
+            smap[keys[i]] = i;
+    }, 1);
+    Expect(fmap.size() == num);
+
+    // erase every 3rd element. remaining ones must be still reachable after backward shifts.
+    for (int i = 0; i < num; i += 3)
+        Expect(fmap.erase(keys[i]));
+    Expect(!fmap.erase(keys[0]));
+
+    bool ok = true;
+    for (int i = 0; i < num; ++i) {
+        auto *v = fmap.find(keys[i]);
+        if (i % 3 == 0)
+            ok = ok && !v;
+        else
+            ok = ok && v && *v == i;
+    }
+    Expect(ok);
+
+    int count = 0;
+    fmap.each([&](const std::string&, int&) { ++count; });
+    Expect(count == (int)fmap.size());
+
+    // sequential integer keys
+    flat_hash_map<int, int> imap;
+    for (int i = 0; i < num; ++i)
+        imap[i] = i * 2;
+    for (int i = 0; i < num; i += 2)
+        imap.erase(i);
+    ok = imap.size() == num / 2;
+    for (int i = 1; i < num; i += 2)
+        ok = ok && imap.find(i) && *imap.find(i) == i * 2;
+    Expect(ok);
+}
+
 TestCase(TestCompareRawVector)
 {
     const size_t input_size = 10000000;
@@ -1090,5 +1475,174 @@ TestCase(Test_Quadify)
         RawVector<int> dst_indices, dst_counts;
         QuadifyTriangles(points, triangles, false, 15.0f, dst_indices, dst_counts);
         Expect(dst_counts.size() == 4);
+
+        // full search looks up neighbors with connection
+        MeshConnectionInfo connection;
+        dst_indices.clear();
+        dst_counts.clear();
+        QuadifyTriangles(points, triangles, true, 15.0f, dst_indices, dst_counts, connection);
+        Expect(dst_counts.size() == 4);
+        Expect(connection.isBuilt(9, 24));
+    }
+}
+
+TestCase(Test_TaskGroup)
+{
+    const int num_tasks = 100000;
+
+    std::atomic<int> count{ 0 };
+    TestScope("task_group", [&]() {
+        task_group group;
+        for (int i = 0; i < num_tasks; ++i)
+            group.run([&count]() { ++count; });
+        group.wait();
+    }, 1);
+    Expect(count == num_tasks);
+
+    // nested tasks and waits
+    count = 0;
+    {
+        task_group outer;
+        for (int i = 0; i < 100; ++i) {
+            outer.run([&count]() {
+                task_group inner;
+                for (int j = 0; j < 100; ++j)
+                    inner.run([&count]() { ++count; });
+                inner.wait();
+            });
+        }
+        outer.wait();
+    }
+    Expect(count == 10000);
+
+    // backpressure and futures
+    {
+        task_group group(4);
+        std::vector<std::future<void>> futures;
+        for (int i = 0; i < 100; ++i)
+            futures.push_back(group.async([&group]() { Expect(group.getNumPending() <= 4); }));
+        for (auto& f : futures)
+            f.wait();
+    }
+
+    // non-worker threads wait without running tasks of other groups
+    {
+        auto this_thread = std::this_thread::get_id();
+        std::atomic<bool> stolen{ false };
+        task_group others, group;
+        for (int i = 0; i < 10000; ++i)
+            others.run([&]() { if (std::this_thread::get_id() == this_thread) stolen = true; });
+        group.run([]() {});
+        group.wait();
+        others.wait();
+        Expect(!stolen);
+    }
+}
+
+TestCase(Test_ParallelFor)
+{
+    const int num = 10000000;
+
+    RawVector<float> data(num);
+    TestScope("parallel_for", [&]() {
+        parallel_for_blocked(0, num, 1024 * 64, [&](int begin, int end) {
+            for (int i = begin; i < end; ++i)
+                data[i] = std::sqrt((float)i);
+        });
+    }, 10);
+    TestScope("serial", [&]() {
+        for (int i = 0; i < num; ++i)
+            data[i] = std::sqrt((float)i);
+    }, 10);
+
+    // every index must be visited exactly once, including offset ranges
+    std::vector<std::atomic<int>> counts(1000);
+    for (auto& c : counts)
+        c = 0;
+    parallel_for(100, 1000, 7, [&](int i) { ++counts[i]; });
+    bool ok = true;
+    for (int i = 0; i < 1000; ++i)
+        ok = ok && counts[i] == (i < 100 ? 0 : 1);
+    Expect(ok);
+
+    // nested. also must not deadlock with a lock held by the caller.
+    std::mutex mutex;
+    std::atomic<int> count{ 0 };
+    parallel_for(0, 64, [&](int) {
+        std::unique_lock<std::mutex> lock(mutex);
+        parallel_for(0, 100, [&](int) { ++count; });
+    });
+    Expect(count == 6400);
+
+    std::vector<int> values(100, 1);
+    count = 0;
+    parallel_for_each(values.begin(), values.end(), [&](int v) { count += v; });
+    parallel_invoke([&]() { ++count; }, [&]() { ++count; });
+    Expect(count == 102);
+
+    bool thrown = false;
+    try {
+        parallel_for(0, 1000, 1, [](int i) {
+            if (i == 500)
+                throw std::runtime_error("test");
+        });
+    }
+    catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    Expect(thrown);
+}
+
+TestCase(Test_WeldMap)
+{
+    // grid of quads that don't share vertices. every inner vertex has duplicates.
+    const int div = 256;
+    RawVector<float3> points;
+    for (int y = 0; y < div; ++y) {
+        for (int x = 0; x < div; ++x) {
+            points.push_back(float3{ (float)x, (float)y, 0.0f });
+            points.push_back(float3{ (float)x + 1, (float)y, 0.0f });
+            points.push_back(float3{ (float)x + 1, (float)y + 1, 0.0f });
+            points.push_back(float3{ (float)x, (float)y + 1, 0.0f });
+        }
+    }
+    points[1].z = -0.0f;
+
+    MeshConnectionInfo connection;
+    TestScope("BuildWeldMap", [&]() {
+        impl::BuildWeldMap(connection, points);
+    }, 1);
+
+    // same result as searching the first vertex at the same position
+    bool ok = true;
+    for (int vi = 0; vi < (int)points.size() && vi < 4096; ++vi) {
+        int r = vi;
+        for (int i = 0; i < vi; ++i) {
+            if (points[i] == points[vi]) {
+                r = i;
+                break;
+            }
+        }
+        ok = ok && connection.weld_map[vi] == r;
+    }
+    Expect(ok);
+    Expect(connection.weld_counts[connection.weld_map[2]] == 4);
+
+    // with epsilon
+    for (auto& p : points)
+        p.x += 0.001f * (float)((&p - points.data()) & 3);
+    impl::BuildWeldMap(connection, points, 0.01f);
+    Expect(connection.weld_counts[connection.weld_map[2]] == 4);
+    impl::BuildWeldMap(connection, points);
+    Expect(connection.weld_counts[connection.weld_map[2]] == 1);
+
+    // chain of vertices each within epsilon of the previous one. all must be welded to the root.
+    {
+        RawVector<float3> chain = { {0.0f, 0.0f, 0.0f}, {0.008f, 0.0f, 0.0f}, {0.016f, 0.0f, 0.0f} };
+        RawVector<int> indices = { 0, 1, 2 };
+        MeshConnectionInfo c;
+        c.buildConnection(indices, 3, chain, true, 0.01f);
+        Expect(c.weld_map[0] == 0 && c.weld_map[1] == 0 && c.weld_map[2] == 0);
+        Expect(c.weld_counts[0] == 3 && c.weld_counts[1] == 0 && c.weld_counts[2] == 0);
     }
 }
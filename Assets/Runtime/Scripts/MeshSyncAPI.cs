@@ -127,6 +127,9 @@ namespace UTJ.MeshSync
         public ushort port;
         public uint meshSplitUnit;
         public int meshMaxBoneInfluence; // -1 (variable) or 4
+        public int requestTimeoutMs; // get, query and screenshot
+        public int pollTimeoutMs;
+        public int maxRetainedMeshes; // base meshes of deltas. least recently used ones are discarded beyond this. 0: unlimited
 
         public static ServerSettings defaultValue
         {
@@ -147,6 +150,9 @@ namespace UTJ.MeshSync
 #else
                     meshMaxBoneInfluence = 4,
 #endif
+                    requestTimeoutMs = 3000,
+                    pollTimeoutMs = 10000,
+                    maxRetainedMeshes = 1024,
                 };
             }
         }
@@ -219,6 +225,8 @@ namespace UTJ.MeshSync
         Screenshot,
         Query,
         Response,
+        Poll,
+        Delta,
     }
 
     public struct GetFlags